@@ -1,272 +1,1875 @@
-// Temperature Monitoring System - Arduino Sketch
-// UPDATED: Uses DallasTemperature library with configurable resolution
-// 
-// Library: DallasTemperature (by Miles Burton)
-// Install: Sketch > Include Library > Manage Libraries > Search "DallasTemperature" > Install
-//
-// Supports:
-// - DS18B20 temperature sensors (1-Wire protocol)
-// - Configurable resolution (9, 10, 11, 12-bit)
-// - Non-blocking temperature reading
-// - Multiple sensors on same wire
-//
-// OUTPUT FORMAT (unchanged - compatible with Raspberry Pi):
-// sensor_id1:temp1,sensor_id2:temp2,sensor_id3:temp3
-// Example: 28abc123:23.45,28def456:22.10,28xyz789:21.55
-
-#include <OneWire.h>
-#include <DallasTemperature.h>
-
-// ============================================================================
-// CONFIGURATION
-// ============================================================================
-
-// Pin where DS18B20 data line is connected
-const int ONE_WIRE_BUS = 2;  // Change if using different pin
-
-// Temperature sensor resolution (9, 10, 11, or 12 bits)
-// 9-bit:  0.5°C steps,   ~94ms conversion
-// 10-bit: 0.25°C steps,  ~188ms conversion
-// 11-bit: 0.125°C steps, ~375ms conversion
-// 12-bit: 0.0625°C steps, ~750ms conversion (default)
-const int TEMPERATURE_RESOLUTION = 10;  // Change for faster/slower polling
-
-// Polling interval (milliseconds)
-// Safe minimum depends on resolution:
-// 9-bit:  100ms+ (gives ~6x faster polling than 12-bit)
-// 10-bit: 200ms+
-// 11-bit: 400ms+
-// 12-bit: 800ms+
-const unsigned long POLL_INTERVAL = 250;  // 250ms safe for 10-bit resolution
-
-// Serial communication
-const long SERIAL_BAUD = 9600;
-
-// ============================================================================
-// ONEWIRE & DALLAS TEMPERATURE SETUP
-// ============================================================================
-
-OneWire oneWire(ONE_WIRE_BUS);
-DallasTemperature sensors(&oneWire);
-
-// ============================================================================
-// TIMING & STATE MANAGEMENT
-// ============================================================================
-
-unsigned long lastPollTime = 0;
-boolean conversionInProgress = false;
-
-// ============================================================================
-// SETUP
-// ============================================================================
-
-void setup() {
-  Serial.begin(SERIAL_BAUD);
-  delay(1000);  // Wait for serial to stabilize
-  
-  // Initialize Dallas Temperature Library
-  sensors.begin();
-  
-  // Set resolution for ALL sensors on the bus
-  sensors.setResolution(TEMPERATURE_RESOLUTION);
-  
-  // Enable non-blocking mode (important for polling speed)
-  sensors.setWaitForConversion(false);
-  
-  // Print startup info
-  Serial.println("[INIT] Temperature Monitoring System");
-  Serial.print("[INIT] Resolution: ");
-  Serial.print(TEMPERATURE_RESOLUTION);
-  Serial.println("-bit");
-  Serial.print("[INIT] Poll interval: ");
-  Serial.print(POLL_INTERVAL);
-  Serial.println("ms");
-  Serial.print("[INIT] Sensors found: ");
-  Serial.println(sensors.getDeviceCount());
-  Serial.println("[INIT] Ready");
-}
-void handleSerialCommands();  // Forward declaration
-void readAndPrintTemperatures();  // Forward declaration
-String addressToString(DeviceAddress deviceAddress);  // Forward declaration
-void handleSerialCommands();  // Forward declaration
-void printDeviceAddress(DeviceAddress deviceAddress);  // Forward declaration
-
-// ============================================================================
-// MAIN LOOP
-// ============================================================================
-
-void loop() {
-  unsigned long currentTime = millis();
-  
-  // Non-blocking polling: respect minimum conversion time
-  if (currentTime - lastPollTime >= POLL_INTERVAL) {
-    if (!conversionInProgress) {
-      // Start a new conversion on all sensors
-      sensors.requestTemperatures();
-      conversionInProgress = true;
-      lastPollTime = currentTime;
-    } else {
-      // Previous conversion completed, now read the values
-      readAndPrintTemperatures();
-      conversionInProgress = false;
-    }
-  }
-  
-  // Handle incoming serial commands (RESCAN, etc.)
-  handleSerialCommands();
-}
-
-// ============================================================================
-// READ TEMPERATURES AND OUTPUT
-// ============================================================================
-
-void readAndPrintTemperatures() {
-  int deviceCount = sensors.getDeviceCount();
-  
-  if (deviceCount == 0) {
-    Serial.println("[ERROR] No temperature sensors found on bus");
-    return;
-  }
-  
-  // Build output string: ID1:temp1,ID2:temp2,ID3:temp3
-  String output = "";
-  
-  for (int i = 0; i < deviceCount; i++) {
-    DeviceAddress deviceAddress;
-    
-    // Get sensor address
-    if (!sensors.getAddress(deviceAddress, i)) {
-      Serial.print("[ERROR] Could not get address for sensor ");
-      Serial.println(i);
-      continue;
-    }
-    
-    // Get temperature (already available from requestTemperatures call)
-    float tempC = sensors.getTempC(deviceAddress);
-    
-    // Skip if reading failed (temp = -127 indicates error)
-    if (tempC == -127.0) {
-      Serial.print("[ERROR] Failed to read sensor ");
-      printDeviceAddress(deviceAddress);
-      Serial.println();
-      continue;
-    }
-    
-    // Append to output string
-    if (output.length() > 0) {
-      output += ",";
-    }
-    
-    // Format: "28abc123:23.45"
-    output += addressToString(deviceAddress);
-    output += ":";
-    output += String(tempC, 2);  // 2 decimal places
-  }
-  
-  // Send to Raspberry Pi
-  if (output.length() > 0) {
-    Serial.println(output);
-  }
-}
-
-// ============================================================================
-// UTILITY: ADDRESS TO STRING (HEX)
-// ============================================================================
-
-String addressToString(DeviceAddress deviceAddress) {
-  String address = "";
-  for (uint8_t i = 0; i < 8; i++) {
-    if (deviceAddress[i] < 16) address += "0";
-    address += String(deviceAddress[i], HEX);
-  }
-  return address;
-}
-
-// ============================================================================
-// UTILITY: PRINT DEVICE ADDRESS (FOR DEBUG)
-// ============================================================================
-
-void printDeviceAddress(DeviceAddress deviceAddress) {
-  for (uint8_t i = 0; i < 8; i++) {
-    if (deviceAddress[i] < 16) Serial.print("0");
-    Serial.print(deviceAddress[i], HEX);
-  }
-}
-
-// ============================================================================
-// SERIAL COMMAND HANDLING (RESCAN, RESOLUTION CHANGE, etc.)
-// ============================================================================
-
-void handleSerialCommands() {
-  if (Serial.available()) {
-    String command = Serial.readStringUntil('\n');
-    command.trim();
-    
-    if (command == "RESCAN") {
-      // Rescan for sensors (useful if hot-swapping)
-      sensors.begin();
-      Serial.print("[INFO] RESCAN_COMPLETE Found ");
-      Serial.print(sensors.getDeviceCount());
-      Serial.println(" sensors");
-    } 
-    else if (command.startsWith("RESOLUTION:")) {
-      // Change resolution on the fly
-      // Example: "RESOLUTION:11" sets all sensors to 11-bit
-      int newResolution = command.substring(11).toInt();
-      if (newResolution >= 9 && newResolution <= 12) {
-        sensors.setResolution(newResolution);
-        Serial.print("[INFO] Resolution changed to ");
-        Serial.print(newResolution);
-        Serial.println("-bit");
-      } else {
-        Serial.println("[ERROR] Resolution must be 9, 10, 11, or 12");
-      }
-    }
-    else if (command == "STATUS") {
-      // Return status info
-      Serial.print("[INFO] Sensors: ");
-      Serial.print(sensors.getDeviceCount());
-      Serial.print(" | Resolution: ");
-      Serial.print(TEMPERATURE_RESOLUTION);
-      Serial.print("-bit | Poll interval: ");
-      Serial.print(POLL_INTERVAL);
-      Serial.println("ms");
-    }
-    else if (command != "") {
-      // Unknown command
-      Serial.print("[WARN] Unknown command: ");
-      Serial.println(command);
-    }
-  }
-}
-
-// ============================================================================
-// NOTES FOR RASPBERRY PI COMPATIBILITY
-// ============================================================================
-//
-// OUTPUT FORMAT (unchanged):
-// ✅ Single line per poll cycle
-// ✅ Format: "28abc123:23.45,28def456:22.10"
-// ✅ No extra debug messages between readings
-// ✅ Serial baud: 9600 (standard)
-//
-// PROTOCOL (unchanged):
-// ✅ Comma-separated sensor readings
-// ✅ Colon separates ID from temperature
-// ✅ Temperature in Celsius, 2 decimal places
-// ✅ Info/error messages prefixed with [INFO], [ERROR], [WARN]
-//
-// COMPATIBILITY:
-// ✅ No breaking changes to Raspberry Pi code
-// ✅ Flask backend expects same format
-// ✅ CSV logging unchanged
-// ✅ Sensor renaming still works
-// ✅ Graphing still works
-//
-// BENEFITS OF THIS VERSION:
-// ✅ Faster polling with 9-bit resolution (~100ms intervals)
-// ✅ Still 0.5°C accuracy (good enough for most applications)
-// ✅ Non-blocking reads prevent serial lag
-// ✅ On-the-fly RESOLUTION change support
-// ✅ Better error handling
-
+// Temperature Monitoring System - Arduino Sketch
+// UPDATED: Lean built-in scratchpad driver (DallasTemperature still selectable)
+// 
+// Library: OneWire (by Paul Stoffregen)
+// Optional: DallasTemperature (by Miles Burton), build with USE_LEAN_DRIVER=0
+// Install: Sketch > Include Library > Manage Libraries > Search "OneWire" > Install
+//
+// Supports:
+// - DS18B20 temperature sensors (1-Wire protocol), DS1822/DS18S20 too
+// - Up to MAX_PROBES sensors (ROM table cached at scan time)
+// - Configurable resolution (9, 10, 11, 12-bit)
+// - Non-blocking temperature reading
+// - Multiple sensors on same wire
+// - Partial scratchpad reads on clean probes (PROBES lists the mode)
+// - BENCH:<probes>,<hz> link/host throughput benchmark (no bus access)
+// - CAPTURE:<i>[+<i>...][,<ms>] 9-bit burst capture to SRAM, dumped at the end
+// - TRIGGER:<slope>[,<every>] per-probe dT/dt trigger into fast 9-bit sampling
+// - TIME:<token> clock ping-pong so the host can map millis() onto its clock
+// - READ:<rom>[,<bits>] one probe converted on its own, with its latency
+// - ADAPT:<budget> per-probe resolution from slope/spread under a bus-time budget
+// - "#<id> CMD" tagged commands, answered "#<id> OK ..." / "#<id> ERR ...",
+//   queued (COMMAND_QUEUE_DEPTH deep) so a host can pipeline them
+//
+// OUTPUT FORMAT (default, FORMAT:SCHEMA):
+// SCHEMA:<version>:rom1,rom2,rom3    (sorted ROMs; on change, every
+//                                     SCHEMA_INTERVAL frames and on request)
+// @<version>/<millis>:temp1,temp2    (positional; empty = failed read;
+//                                     millis() when the probes were read)
+// Example: SCHEMA:3f1a:28abc1230000beef,28def4560000cafe,28fed9870000f00d
+//          @3f1a/81250:23.45,,21.55
+//
+// LEGACY FORMAT (FORMAT:FULL, unchanged - compatible with Raspberry Pi):
+// sensor_id1:temp1,sensor_id2:temp2,sensor_id3:temp3
+// Example: 28abc123:23.45,28def456:22.10,28xyz789:21.55
+
+// Probe driver selection:
+// 1 = lean driver below (direct scratchpad reads with CRC, default)
+// 0 = DallasTemperature library
+// Override from platformio.ini: build_flags = -DUSE_LEAN_DRIVER=0
+#ifndef USE_LEAN_DRIVER
+#define USE_LEAN_DRIVER 1
+#endif
+
+#include <OneWire.h>
+#if !USE_LEAN_DRIVER
+#include <DallasTemperature.h>
+#endif
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+// Pin where DS18B20 data line is connected
+const int ONE_WIRE_BUS = 2;  // Change if using different pin
+
+// Temperature sensor resolution (9, 10, 11, or 12 bits)
+// 9-bit:  0.5°C steps,   ~94ms conversion
+// 10-bit: 0.25°C steps,  ~188ms conversion
+// 11-bit: 0.125°C steps, ~375ms conversion
+// 12-bit: 0.0625°C steps, ~750ms conversion (default)
+const int TEMPERATURE_RESOLUTION = 10;  // Change for faster/slower polling
+
+// Polling interval (milliseconds)
+// Safe minimum depends on resolution:
+// 9-bit:  100ms+ (gives ~6x faster polling than 12-bit)
+// 10-bit: 200ms+
+// 11-bit: 400ms+
+// 12-bit: 800ms+
+const unsigned long POLL_INTERVAL = 250;  // 250ms safe for 10-bit resolution
+
+// Serial communication
+const long SERIAL_BAUD = 9600;
+
+// Probes tracked per bus. Each costs 17 bytes of SRAM: 11 always (8 ROM,
+// 2 last reading, 1 lean-driver read state) and 6 of trigger/ADAPT state
+// (2 slope, 3 history, 1 adapt) that the CAPTURE ring reuses. Frames are
+// streamed, so there is no per-probe String heap. 64 keeps the globals near
+// 1.55 KB of the Uno's 2 KB, leaving the rest for the stack and command Strings.
+const int MAX_PROBES = 64;
+
+// Valid DS18B20 range in raw 1/16 °C counts (-55°C .. +125°C)
+const int16_t RAW_TEMP_MIN = -55 * 16;
+const int16_t RAW_TEMP_MAX = 125 * 16;
+
+// Partial scratchpad reads (lean driver). A probe with no recent CRC errors
+// reads only the 2 temperature bytes; every Nth cycle it still does a full
+// CRC-checked read so the error rate keeps being sampled.
+const uint8_t PARTIAL_READ_AUDIT_INTERVAL = 16;  // Full read every N cycles
+const uint8_t PARTIAL_READ_WARMUP = 8;           // Clean full reads before going partial
+const uint8_t PARTIAL_READ_ERROR_PENALTY = 32;   // Clean full reads owed per failure (63 at most)
+
+// Schema frames: resend the ROM list at least this often (in data frames)
+const uint8_t SCHEMA_INTERVAL = 60;
+
+// Burst capture (CAPTURE command). Records are 1 + probes words (ms delta,
+// raw samples); the ring is the trigger/ADAPT state's memory (3 words per
+// probe), so 192 words hold 64 sweeps of 2 probes or 38 of 4.
+const uint8_t CAPTURE_MAX_PROBES = 4;
+const uint8_t CAPTURE_RESOLUTION = 9;
+
+// Rate-of-change trigger (TRIGGER command)
+const uint8_t TRIGGER_MAX_FAST = 4;      // Probes sampled fast at once
+const uint8_t TRIGGER_HISTORY = 3;       // Withheld cycles kept per probe (pre-trigger)
+const uint8_t TRIGGER_HOLD_CYCLES = 8;   // Quiet cycles before a fast probe relaxes
+const uint8_t TRIGGER_RESOLUTION = 9;
+
+// Adaptive per-probe resolution (ADAPT command)
+const uint8_t ADAPT_SETTLE_CYCLES = 4;     // Quiet cycles before a probe gains a bit
+const unsigned long ADAPT_BURST_MS = 200;  // Bus time that may be saved up under the budget
+
+// Single-probe read (READ command)
+const uint8_t READ_RESOLUTION = 9;  // Default when READ gives no <bits>
+
+// Link benchmark (BENCH command)
+const int BENCH_MAX_PROBES = 64;                 // Virtual probes per frame
+const unsigned long BENCH_DURATION_MS = 10000;   // Default run length
+
+// Host commands are queued as their bytes arrive; each slot costs
+// COMMAND_MAX_LENGTH + 1 bytes of SRAM
+const uint8_t COMMAND_QUEUE_DEPTH = 4;  // Commands a host may have in flight
+const uint8_t COMMAND_MAX_LENGTH = 32;  // Including a "#<id> " tag
+
+// ============================================================================
+// ONEWIRE SETUP & PROBE TABLE
+// ============================================================================
+
+OneWire oneWire(ONE_WIRE_BUS);
+#if !USE_LEAN_DRIVER
+DallasTemperature sensors(&oneWire);
+#endif
+
+// Filled by scanProbes(); index order is sorted ROM order (the schema order)
+uint8_t probeAddresses[MAX_PROBES][8];
+int16_t probeRaw[MAX_PROBES];  // Last reading of the current cycle
+uint8_t probeCount = 0;
+uint8_t activeResolution = TEMPERATURE_RESOLUTION;
+
+// Schema frames: version is a CRC-16 of the sorted ROM set, so it is the
+// same after a reset and changes whenever a probe comes or goes
+boolean schemaFrames = true;
+uint16_t schemaVersion = 0;
+uint8_t framesSinceSchema = SCHEMA_INTERVAL;  // Send one before the first frame
+const int16_t PROBE_NO_READING = -32767 - 1;  // Never a valid scratchpad value here
+
+// ============================================================================
+// TIMING & STATE MANAGEMENT
+// ============================================================================
+
+unsigned long lastPollTime = 0;
+boolean conversionInProgress = false;
+
+// Per-probe trigger and ADAPT state. CAPTURE stops the poll cycle, so its
+// ring reuses this memory and the state starts over when the capture ends.
+struct ProbeTrends {
+  int16_t slope[MAX_PROBES];                    // EWMA of dT/dt, 1/100 °C per s
+  int8_t history[MAX_PROBES][TRIGGER_HISTORY];  // Per-cycle deltas, newest first
+  uint8_t adapt[MAX_PROBES];                    // Low 2 bits: resolution - 9; rest: quiet cycles
+};
+const uint16_t CAPTURE_RING_WORDS = sizeof(ProbeTrends) / sizeof(int16_t);
+static union {
+  ProbeTrends trends;
+  int16_t captureRing[CAPTURE_RING_WORDS];
+};
+const int8_t HISTORY_UNKNOWN = -128;
+
+// Rate-of-change trigger: the fast set
+uint16_t triggerThreshold = 0;  // 1/100 °C per s; 0 = off
+uint8_t relaxedEvery = 1;       // Steady state: send every Nth frame
+uint8_t cyclesWithheld = 0;
+unsigned long lastCycleMs = 0;
+unsigned long lastCycleLengthMs = POLL_INTERVAL;
+uint8_t fastCount = 0;
+uint8_t fastProbes[TRIGGER_MAX_FAST];
+uint8_t fastHold[TRIGGER_MAX_FAST];
+int16_t fastRaw[TRIGGER_MAX_FAST];
+boolean fastConverting = false;
+unsigned long fastConvertMs = 0;
+
+// Adaptive resolution and bus-time accounting
+uint8_t adaptBudget = 0;           // % of time the bus may be busy; 0 = off
+uint8_t adaptCycleBits = TEMPERATURE_RESOLUTION;  // Slowest probe this cycle
+long busCredit = 0;                // 1/100 us of bus time still allowed
+unsigned long busCreditUs = 0;
+unsigned long busBusyUs = 0;       // Bus time since busWindowUs
+unsigned long busWindowUs = 0;
+uint8_t busUtilization = 0;        // % over the last poll cycle
+
+// BENCH mode: synthetic frames instead of bus reads
+boolean benchActive = false;
+int benchProbes = 0;
+unsigned long benchIntervalUs = 0;
+unsigned long benchDurationMs = 0;
+unsigned long benchStartMs = 0;
+unsigned long benchNextUs = 0;
+unsigned long benchFrames = 0;
+unsigned long benchBytes = 0;
+uint16_t benchSchemaVersion = 0;
+
+// CAPTURE mode: back-to-back conversions on a few probes into a ring
+boolean captureActive = false;
+boolean captureConverting = false;
+uint8_t captureProbes[CAPTURE_MAX_PROBES];  // Probe table indices
+uint8_t captureCount = 0;
+uint16_t captureCapacity = 0;  // Records that fit
+uint16_t captureHead = 0;      // Next record slot (oldest once full)
+uint16_t captureStored = 0;
+unsigned long captureOverwritten = 0;
+unsigned long captureDurationMs = 0;  // 0 = stop when the ring is full
+unsigned long captureStartMs = 0;
+unsigned long captureConvertMs = 0;
+unsigned long captureLastMs = 0;    // Time of the newest record
+unsigned long captureOldestMs = 0;  // Time of the oldest record
+
+// READ command: one probe converted on its own, ahead of the schedule
+boolean readPending = false;     // Waiting for the bus to go idle
+boolean readConverting = false;
+uint8_t readIndex = 0;
+uint8_t readBits = READ_RESOLUTION;
+long readTag = -1;               // Tag of the READ, for its late reply
+unsigned long readRequestMs = 0;
+unsigned long readConvertMs = 0;
+
+// Command queue: a ring of received lines, plus the command being run
+char commandQueue[COMMAND_QUEUE_DEPTH][COMMAND_MAX_LENGTH + 1];
+uint8_t commandQueueHead = 0;   // Oldest complete line
+uint8_t commandQueueCount = 0;  // Complete lines; the slot after them is being received
+uint8_t commandLength = 0;      // Bytes so far of the line being received
+uint8_t commandTruncated = 0;   // Bit per slot: line was longer than COMMAND_MAX_LENGTH
+long commandTag = -1;           // "#<id>" of the running command; -1 = untagged
+boolean commandReplied = false; // Running command has sent its OK/ERR line
+const uint8_t REPLY_OK = 0;
+const uint8_t REPLY_MORE = 1;
+const uint8_t REPLY_ERROR = 2;
+const uint8_t REPLY_WARN = 3;
+
+// ============================================================================
+// SETUP
+// ============================================================================
+
+void scanProbes();  // Forward declaration
+void setAllResolution(uint8_t bits);  // Forward declaration
+uint16_t schemaHashAdd(uint16_t hash, const uint8_t* address);  // Forward declaration
+size_t printSchemaVersion(uint16_t version);  // Forward declaration
+void printSchema();  // Forward declaration
+
+void setup() {
+  Serial.begin(SERIAL_BAUD);
+  delay(1000);  // Wait for serial to stabilize
+  
+  // Find probes and set resolution for ALL of them
+  scanProbes();
+  setAllResolution(activeResolution);
+  
+  // Print startup info
+  Serial.println(F("[INIT] Temperature Monitoring System"));
+  Serial.print(F("[INIT] Driver: "));
+  Serial.println(USE_LEAN_DRIVER ? F("lean") : F("DallasTemperature"));
+  Serial.print(F("[INIT] Resolution: "));
+  Serial.print(activeResolution);
+  Serial.println(F("-bit"));
+  Serial.print(F("[INIT] Poll interval: "));
+  Serial.print(POLL_INTERVAL);
+  Serial.println(F("ms"));
+  Serial.print(F("[INIT] Sensors found: "));
+  Serial.println(probeCount);
+  Serial.println(F("[INIT] Ready"));
+}
+void handleSerialCommands();  // Forward declaration
+void readAndPrintTemperatures();  // Forward declaration
+uint8_t formatAddress(char* out, const uint8_t* deviceAddress);  // Forward declaration
+uint8_t formatTemperature(char* out, int16_t raw);  // Forward declaration
+void printDeviceAddress(const uint8_t* deviceAddress);  // Forward declaration
+void requestConversion();  // Forward declaration
+boolean usesPartialRead(uint8_t index);  // Forward declaration
+boolean readProbeRaw(uint8_t index, int16_t* raw);  // Forward declaration
+void startBench(String args);  // Forward declaration
+void runBench();  // Forward declaration
+void stopBench();  // Forward declaration
+void benchAddress(uint8_t* address, int index);  // Forward declaration
+void startCapture(String args);  // Forward declaration
+void printFrame(boolean fast);  // Forward declaration
+int16_t frameValue(uint8_t index, boolean fast);  // Forward declaration
+void updateSlope(uint8_t index, int16_t raw, unsigned long elapsedMs);  // Forward declaration
+int8_t fastSlot(uint8_t index);  // Forward declaration
+void updateTriggers();  // Forward declaration
+void triggerProbe(uint8_t index);  // Forward declaration
+void relaxProbe(uint8_t slot, boolean announce);  // Forward declaration
+void resetTriggers();  // Forward declaration
+void runFastSampling();  // Forward declaration
+void restartFastClock();  // Forward declaration
+void requestProbeConversion(uint8_t index);  // Forward declaration
+void runCapture();  // Forward declaration
+void stopCapture();  // Forward declaration
+void pollSerial();  // Forward declaration
+void beginReply(uint8_t kind);  // Forward declaration
+void runCommand(String command);  // Forward declaration
+boolean textIs(const String& text, PGM_P name);  // Forward declaration
+boolean textStarts(const String& text, PGM_P prefix);  // Forward declaration
+void startSingleRead(String args);  // Forward declaration
+void runSingleRead();  // Forward declaration
+uint8_t scheduledResolution(uint8_t index);  // Forward declaration
+void addFastProbe(uint8_t index);  // Forward declaration
+uint8_t fastResolution();  // Forward declaration
+void updateAdaptive(unsigned long cycleMs);  // Forward declaration
+void chargeBus(unsigned long busyUs);  // Forward declaration
+boolean busAllowed();  // Forward declaration
+void measureBusUtilization();  // Forward declaration
+void runAdaptivePoll(unsigned long currentTime);  // Forward declaration
+void resetAdaptive();  // Forward declaration
+
+// ============================================================================
+// MAIN LOOP
+// ============================================================================
+
+void loop() {
+  unsigned long currentTime = millis();
+  
+  // BENCH mode owns the serial link; the bus is not touched
+  if (benchActive) {
+    runBench();
+    handleSerialCommands();
+    return;
+  }
+  
+  // CAPTURE mode owns the bus until its dump is done
+  if (captureActive) {
+    runCapture();
+    handleSerialCommands();
+    return;
+  }
+  
+  // READ preempts the poll schedule until its probe is read; other
+  // commands wait in the queue
+  if (readPending || readConverting) {
+    runSingleRead();
+    pollSerial();
+    return;
+  }
+  
+  // Non-blocking polling: respect minimum conversion time
+  if (adaptBudget > 0) {
+    runAdaptivePoll(currentTime);
+  } else if (currentTime - lastPollTime >= POLL_INTERVAL) {
+    if (!conversionInProgress) {
+      // Start a new conversion on all sensors
+      requestConversion();
+      conversionInProgress = true;
+      lastPollTime = currentTime;
+      restartFastClock();
+    } else {
+      // Previous conversion completed, now read the values
+      readAndPrintTemperatures();
+      conversionInProgress = false;
+    }
+  }
+  
+  // Triggered probes are sampled between poll cycles
+  if (fastCount > 0) {
+    runFastSampling();
+  }
+  
+  // Handle incoming serial commands (RESCAN, etc.)
+  handleSerialCommands();
+}
+
+// ============================================================================
+// PROBE DRIVER
+// ============================================================================
+//
+// scanProbes() caches every ROM once, so a poll cycle is one broadcast
+// convert plus one 9-byte scratchpad read per probe. The lean driver talks
+// to the scratchpad directly (the approach of bkp/main.cpp) and skips
+// DallasTemperature's per-reading address search and isConnected() re-read.
+
+// Read slots after a Convert T answer 0 until that conversion is done, but
+// only up to the next reset: after one they read 1 at once. Which conversion
+// they still answer for (a probe index, or all/none):
+const uint8_t CONVERSION_ALL = 0xFE;
+const uint8_t CONVERSION_NONE = 0xFF;
+uint8_t pollableConversion = CONVERSION_NONE;
+
+#if USE_LEAN_DRIVER
+
+// DS18x20 ROM commands and function commands
+const uint8_t CMD_CONVERT_T = 0x44;
+const uint8_t CMD_WRITE_SCRATCHPAD = 0x4E;
+const uint8_t CMD_READ_SCRATCHPAD = 0xBE;
+const uint8_t CMD_READ_POWER_SUPPLY = 0xB4;
+const uint8_t FAMILY_DS18S20 = 0x10;
+const uint8_t FAMILY_DS1822 = 0x22;
+const uint8_t FAMILY_DS18B20 = 0x28;
+
+boolean parasitePower = false;
+uint8_t readCycle = 0;
+
+// Per probe, low 6 bits: leaky count of clean full reads still owed before
+// partial reads are trusted (0 = partial); top 2: resolution - 9 of its config
+// byte, which sets the mask for partial reads
+uint8_t probeReadState[MAX_PROBES];
+
+uint8_t errorScore(uint8_t index) {
+  return probeReadState[index] & 0x3F;
+}
+
+void setErrorScore(uint8_t index, uint8_t score) {
+  probeReadState[index] = (probeReadState[index] & 0xC0) | min(score, (uint8_t)0x3F);
+}
+
+// The config byte: resolution in bits 5-6, reserved bits set
+uint8_t probeConfig(uint8_t index) {
+  return ((probeReadState[index] >> 1) & 0x60) | 0x1F;
+}
+
+void setProbeConfig(uint8_t index, uint8_t config) {
+  probeReadState[index] = (probeReadState[index] & 0x3F) | ((config & 0x60) << 1);
+}
+
+// Every transaction starts here, so no stale conversion is polled
+uint8_t busReset() {
+  pollableConversion = CONVERSION_NONE;
+  return oneWire.reset();
+}
+
+// Read a probe's scratchpad; false if absent, all zeros or CRC mismatch
+boolean readScratchpad(const uint8_t* address, uint8_t* scratchpad) {
+  if (!busReset()) return false;
+  oneWire.select(address);
+  oneWire.write(CMD_READ_SCRATCHPAD);
+  oneWire.read_bytes(scratchpad, 9);
+  
+  uint8_t any = 0;
+  for (uint8_t i = 0; i < 9; i++) any |= scratchpad[i];
+  return any != 0 && OneWire::crc8(scratchpad, 8) == scratchpad[8];
+}
+
+void scanBus() {
+  uint8_t address[8];
+  probeCount = 0;
+  pollableConversion = CONVERSION_NONE;  // The search resets the bus
+  oneWire.reset_search();
+  while (oneWire.search(address)) {
+    if (OneWire::crc8(address, 7) != address[7]) continue;
+    if (address[0] != FAMILY_DS18B20 && address[0] != FAMILY_DS1822 && address[0] != FAMILY_DS18S20) continue;
+    if (probeCount >= MAX_PROBES) {
+      Serial.print(F("[WARN] Probe limit reached, ignoring sensors past "));
+      Serial.println(MAX_PROBES);
+      break;
+    }
+    memcpy(probeAddresses[probeCount], address, 8);
+    probeReadState[probeCount] = 0xC0 | PARTIAL_READ_WARMUP;  // 12-bit until the first full read
+    probeCount++;
+  }
+  
+  // Any parasite-powered probe needs the bus held high during conversion
+  parasitePower = false;
+  if (busReset()) {
+    oneWire.skip();
+    oneWire.write(CMD_READ_POWER_SUPPLY);
+    parasitePower = !oneWire.read_bit();
+  }
+}
+
+// Sets the scratchpad config only; TH/TL are kept and nothing is copied to
+// EEPROM, so on-the-fly RESOLUTION changes don't wear it (setup reapplies)
+void setProbeResolution(uint8_t index, uint8_t bits) {
+  const uint8_t* address = probeAddresses[index];
+  uint8_t scratchpad[9];
+  if (address[0] == FAMILY_DS18S20) return;  // Fixed 9-bit part
+  if (!readScratchpad(address, scratchpad)) return;
+  
+  busReset();
+  oneWire.select(address);
+  oneWire.write(CMD_WRITE_SCRATCHPAD);
+  oneWire.write(scratchpad[2]);  // TH
+  oneWire.write(scratchpad[3]);  // TL
+  setProbeConfig(index, (bits - 9) << 5);
+  oneWire.write(probeConfig(index));
+}
+
+void requestConversion() {
+  readCycle++;
+  busReset();
+  oneWire.skip();
+  oneWire.write(CMD_CONVERT_T, parasitePower);
+  pollableConversion = CONVERSION_ALL;
+}
+
+// Convert one probe only (MATCH ROM), leaving the rest of the bus idle
+void requestProbeConversion(uint8_t index) {
+  busReset();
+  oneWire.select(probeAddresses[index]);
+  oneWire.write(CMD_CONVERT_T, parasitePower);
+  pollableConversion = index;
+}
+
+// Externally powered probes hold the bus low until their conversion is
+// done; parasite-powered ones can't, and once another transaction has reset
+// the bus nothing answers, so then fall back to the datasheet time
+boolean conversionDone(unsigned long elapsedMs, uint8_t bits, uint8_t conversion) {
+  if (elapsedMs >= (750UL >> (12 - bits))) return true;
+  return !parasitePower && pollableConversion == conversion && oneWire.read_bit();
+}
+
+// Clear the bits below the resolution set in a config byte (undefined on the part)
+int16_t maskResolution(int16_t value, uint8_t config) {
+  switch (config & 0x60) {
+    case 0x00: return value & ~7;  // 9-bit
+    case 0x20: return value & ~3;  // 10-bit
+    case 0x40: return value & ~1;  // 11-bit
+  }
+  return value;
+}
+
+boolean usesPartialRead(uint8_t index) {
+  return errorScore(index) == 0 && probeAddresses[index][0] != FAMILY_DS18S20;
+}
+
+// Raw reading in 1/16 °C, with bits below the probe's resolution cleared
+boolean readProbeRaw(uint8_t index, int16_t* raw) {
+  const uint8_t* address = probeAddresses[index];
+  
+  // Partial read: 2 bytes then a reset to abort the rest (no CRC to check).
+  // Audit cycles are staggered by index so they don't all land together.
+  if (usesPartialRead(index) && (uint8_t)(readCycle + index) % PARTIAL_READ_AUDIT_INTERVAL != 0) {
+    if (!busReset()) {
+      setErrorScore(index, PARTIAL_READ_ERROR_PENALTY);
+      return false;
+    }
+    oneWire.select(address);
+    oneWire.write(CMD_READ_SCRATCHPAD);
+    uint8_t lsb = oneWire.read();
+    uint8_t msb = oneWire.read();
+    busReset();
+    if (lsb != 0xFF || msb != 0xFF) {
+      *raw = maskResolution((int16_t)((msb << 8) | lsb), probeConfig(index));
+      return true;
+    }
+    // All ones is -0.0625 °C as well as a probe that didn't answer: the
+    // full read below tells them apart, and only its failure costs a penalty
+  }
+  
+  uint8_t scratchpad[9];
+  if (!readScratchpad(address, scratchpad)) {
+    setErrorScore(index, errorScore(index) + PARTIAL_READ_ERROR_PENALTY);
+    return false;
+  }
+  if (errorScore(index) > 0) setErrorScore(index, errorScore(index) - 1);
+  setProbeConfig(index, scratchpad[4]);
+  
+  int16_t value = (int16_t)((scratchpad[1] << 8) | scratchpad[0]);
+  if (address[0] == FAMILY_DS18S20) {
+    // 0.5 °C register refined with COUNT_REMAIN (COUNT_PER_C is 16)
+    value = (int16_t)(((value << 3) & 0xFFF0) + 12 - scratchpad[6]);
+  } else {
+    value = maskResolution(value, scratchpad[4]);
+  }
+  *raw = value;
+  return true;
+}
+
+#else  // DallasTemperature driver
+
+boolean parasitePower = false;
+
+void scanBus() {
+  sensors.begin();
+  sensors.setWaitForConversion(false);  // Non-blocking (important for polling speed)
+  parasitePower = sensors.isParasitePowerMode();
+  pollableConversion = CONVERSION_NONE;
+  
+  uint8_t found = sensors.getDeviceCount();
+  if (found > MAX_PROBES) {
+    Serial.print(F("[WARN] Probe limit reached, ignoring sensors past "));
+    Serial.println(MAX_PROBES);
+    found = MAX_PROBES;
+  }
+  probeCount = 0;
+  for (uint8_t i = 0; i < found; i++) {
+    if (sensors.getAddress(probeAddresses[probeCount], i)) probeCount++;
+  }
+}
+
+void setProbeResolution(uint8_t index, uint8_t bits) {
+  pollableConversion = CONVERSION_NONE;
+  sensors.setResolution(probeAddresses[index], bits);
+}
+
+void requestConversion() {
+  sensors.requestTemperatures();
+  pollableConversion = CONVERSION_ALL;
+}
+
+void requestProbeConversion(uint8_t index) {
+  sensors.requestTemperaturesByAddress(probeAddresses[index]);
+  pollableConversion = index;
+}
+
+boolean conversionDone(unsigned long elapsedMs, uint8_t bits, uint8_t conversion) {
+  if (elapsedMs >= (750UL >> (12 - bits))) return true;
+  return pollableConversion == conversion && sensors.isConversionComplete();
+}
+
+boolean usesPartialRead(uint8_t) {
+  return false;  // The library always reads and checks the full scratchpad
+}
+
+boolean readProbeRaw(uint8_t index, int16_t* raw) {
+  // getTemp() is in 1/128 °C; >> 3 gives scratchpad counts
+  pollableConversion = CONVERSION_NONE;
+  int32_t raw128 = sensors.getTemp(probeAddresses[index]);
+  if (raw128 == DEVICE_DISCONNECTED_RAW) return false;
+  *raw = (int16_t)(raw128 >> 3);
+  return true;
+}
+
+#endif
+
+// Rescan, then sort by ROM so positions are stable for schema frames. The
+// driver's per-probe state is uniform right after a scan, so only the ROMs move.
+void scanProbes() {
+  scanBus();
+  for (uint8_t i = 1; i < probeCount; i++) {
+    uint8_t address[8];
+    memcpy(address, probeAddresses[i], 8);
+    uint8_t j = i;
+    for (; j > 0 && memcmp(probeAddresses[j - 1], address, 8) > 0; j--) {
+      memcpy(probeAddresses[j], probeAddresses[j - 1], 8);
+    }
+    memcpy(probeAddresses[j], address, 8);
+  }
+  
+  uint16_t version = 0xFFFF;
+  for (uint8_t i = 0; i < probeCount; i++) {
+    version = schemaHashAdd(version, probeAddresses[i]);
+  }
+  if (version != schemaVersion) {
+    schemaVersion = version;
+    framesSinceSchema = SCHEMA_INTERVAL;  // Announce before the next frame
+  }
+  resetTriggers();
+}
+
+void setAllResolution(uint8_t bits) {
+  for (uint8_t i = 0; i < probeCount; i++) {
+    setProbeResolution(i, bits);
+  }
+}
+
+// ============================================================================
+// READ TEMPERATURES AND OUTPUT
+// ============================================================================
+
+void readAndPrintTemperatures() {
+  if (probeCount == 0) {
+    Serial.println(F("[ERROR] No temperature sensors found on bus"));
+    return;
+  }
+  
+  unsigned long now = millis();
+  unsigned long cycleMs = now - lastCycleMs;
+  lastCycleMs = now;
+  lastCycleLengthMs = cycleMs;
+  
+  // Pass 1: read every probe. Errors go out now so the frame stays one line.
+  // Everything stays in integers: no soft-float on the AVR.
+  unsigned long busStartUs = micros();
+  uint8_t goodCount = 0;
+  for (uint8_t i = 0; i < probeCount; i++) {
+    int16_t raw;
+    pollSerial();  // A full bus takes long enough to overflow the UART buffer
+    
+    // Skip if reading failed (disconnected, CRC) or is outside the sensor's range
+    if (!readProbeRaw(i, &raw) || raw < RAW_TEMP_MIN || raw > RAW_TEMP_MAX) {
+      updateSlope(i, PROBE_NO_READING, cycleMs);
+      probeRaw[i] = PROBE_NO_READING;
+      Serial.print(F("[ERROR] Failed to read sensor "));
+      printDeviceAddress(probeAddresses[i]);
+      Serial.println();
+      continue;
+    }
+    updateSlope(i, raw, cycleMs);
+    probeRaw[i] = raw;
+    goodCount++;
+  }
+  
+  if (goodCount > 0 && triggerThreshold > 0) updateTriggers();
+  if (goodCount > 0 && adaptBudget > 0) updateAdaptive(cycleMs);
+  chargeBus(micros() - busStartUs);
+  measureBusUtilization();
+  if (goodCount == 0) return;
+  
+  // Steady state: only every relaxedEvery-th frame goes out
+  if (fastCount == 0 && ++cyclesWithheld < relaxedEvery) return;
+  cyclesWithheld = 0;
+  printFrame(false);
+}
+
+// Pass 2: stream a frame from probeRaw, or from fastRaw for a fast frame
+void printFrame(boolean fast) {
+  if (schemaFrames) {
+    // @version/millis:temp1,,temp3 (position = schema order). Fast frames are
+    // read just before printing; slow ones at the start of the poll cycle.
+    if (framesSinceSchema >= SCHEMA_INTERVAL) printSchema();
+    framesSinceSchema++;
+    Serial.print('@');
+    printSchemaVersion(schemaVersion);
+    Serial.print('/');
+    Serial.print(fast ? millis() : lastCycleMs);
+    Serial.print(':');
+    for (uint8_t i = 0; i < probeCount; i++) {
+      if (i > 0) Serial.print(',');
+      int16_t raw = frameValue(i, fast);
+      if (raw == PROBE_NO_READING) continue;
+      char value[8];
+      formatTemperature(value, raw);
+      Serial.print(value);
+    }
+    Serial.println();
+    return;
+  }
+  
+  // ID1:temp1,ID2:temp2,ID3:temp3 to the Raspberry Pi
+  boolean first = true;
+  for (uint8_t i = 0; i < probeCount; i++) {
+    int16_t raw = frameValue(i, fast);
+    if (raw == PROBE_NO_READING) continue;
+    
+    // Format: "28abc123:23.45"
+    char field[26];
+    uint8_t length = formatAddress(field, probeAddresses[i]);
+    field[length++] = ':';
+    formatTemperature(field + length, raw);  // 2 decimal places
+    
+    if (!first) Serial.print(',');
+    Serial.print(field);
+    first = false;
+  }
+  if (!first) Serial.println();
+}
+
+int16_t frameValue(uint8_t index, boolean fast) {
+  if (!fast) return probeRaw[index];
+  int8_t slot = fastSlot(index);
+  return slot < 0 ? PROBE_NO_READING : fastRaw[slot];
+}
+
+// ============================================================================
+// RATE-OF-CHANGE TRIGGER
+// ============================================================================
+//
+// TRIGGER:<slope>[,<every>] with <slope> in 1/100 °C per second. Every poll
+// cycle updates an EWMA of each probe's dT/dt. Crossing <slope> moves the
+// probe (up to TRIGGER_MAX_FAST at once) to 9-bit, converted on its own as
+// fast as it can, and sends its pre-trigger history first:
+//   TRIG:<rom>:<slope>:<cycle ms>:<oldest>,...,<newest>
+// (the cycles withheld since the last frame, oldest first). The probe
+// relaxes after TRIGGER_HOLD_CYCLES cycles below half the threshold:
+//   [INFO] RELAX <rom>
+// Steady frames go out every <every> cycles while nothing is fast.
+// TRIGGER:0 turns it off. With parasite-powered probes on the bus the fast
+// set is only converted by the poll cycle (see runFastSampling()).
+
+// Shift in this cycle's delta and update the slope EWMA (before probeRaw changes)
+void updateSlope(uint8_t index, int16_t raw, unsigned long elapsedMs) {
+  int8_t* history = trends.history[index];
+  memmove(history + 1, history, TRIGGER_HISTORY - 1);
+  
+  int16_t previous = probeRaw[index];
+  int16_t delta = raw - previous;
+  if (raw == PROBE_NO_READING || previous == PROBE_NO_READING || elapsedMs == 0 || delta > 127 || delta < -127) {
+    history[0] = HISTORY_UNKNOWN;
+    return;
+  }
+  history[0] = delta;
+  
+  // 1 count = 6.25 hundredths of a °C; EWMA with weight 1/4
+  int32_t instant = (int32_t)delta * 6250 / (int32_t)elapsedMs;
+  trends.slope[index] += (int16_t)((instant - trends.slope[index]) / 4);
+}
+
+// Resolution the poll schedule keeps a probe at
+uint8_t scheduledResolution(uint8_t index) {
+  if (adaptBudget > 0) return 9 + (trends.adapt[index] & 0x03);
+  return fastSlot(index) >= 0 ? TRIGGER_RESOLUTION : activeResolution;
+}
+
+int8_t fastSlot(uint8_t index) {
+  for (uint8_t slot = 0; slot < fastCount; slot++) {
+    if (fastProbes[slot] == index) return slot;
+  }
+  return -1;
+}
+
+void updateTriggers() {
+  for (uint8_t i = 0; i < probeCount; i++) {
+    int16_t magnitude = abs(trends.slope[i]);
+    int8_t slot = fastSlot(i);
+    if (slot >= 0) {
+      if (magnitude >= (int16_t)(triggerThreshold / 2)) {
+        fastHold[slot] = TRIGGER_HOLD_CYCLES;
+      } else if (--fastHold[slot] == 0) {
+        relaxProbe(slot, true);
+      }
+    } else if (magnitude >= (int16_t)triggerThreshold && fastCount < TRIGGER_MAX_FAST && probeRaw[i] != PROBE_NO_READING) {
+      triggerProbe(i);
+    }
+  }
+}
+
+// Slowest resolution in the fast set
+uint8_t fastResolution() {
+  uint8_t bits = 9;
+  for (uint8_t slot = 0; slot < fastCount; slot++) {
+    bits = max(bits, scheduledResolution(fastProbes[slot]));
+  }
+  return bits;
+}
+
+// Join the fast set, at the resolution the schedule gives fast probes
+void addFastProbe(uint8_t index) {
+  uint8_t slot = fastCount++;
+  fastProbes[slot] = index;
+  fastHold[slot] = TRIGGER_HOLD_CYCLES;
+  fastRaw[slot] = PROBE_NO_READING;
+  fastConverting = false;
+  setProbeResolution(index, scheduledResolution(index));
+}
+
+void triggerProbe(uint8_t index) {
+  addFastProbe(index);
+  
+  char text[17];
+  formatAddress(text, probeAddresses[index]);
+  Serial.print(F("TRIG:"));
+  Serial.print(text);
+  Serial.print(':');
+  Serial.print(trends.slope[index]);
+  Serial.print(':');
+  Serial.print(lastCycleLengthMs);
+  Serial.print(':');
+  
+  // Walk back from the current reading through the withheld cycles
+  uint8_t count = 0;
+  int16_t values[TRIGGER_HISTORY];
+  int16_t value = probeRaw[index];
+  while (count < cyclesWithheld && count < TRIGGER_HISTORY && trends.history[index][count] != HISTORY_UNKNOWN) {
+    value -= trends.history[index][count];
+    values[count++] = value;
+  }
+  while (count > 0) {
+    formatTemperature(text, values[--count]);
+    Serial.print(text);
+    if (count > 0) Serial.print(',');
+  }
+  Serial.println();
+}
+
+void relaxProbe(uint8_t slot, boolean announce) {
+  uint8_t index = fastProbes[slot];
+  fastCount--;
+  fastProbes[slot] = fastProbes[fastCount];
+  fastHold[slot] = fastHold[fastCount];
+  fastRaw[slot] = fastRaw[fastCount];
+  setProbeResolution(index, scheduledResolution(index));
+  if (announce) {
+    Serial.print(F("[INFO] RELAX "));
+    printDeviceAddress(probeAddresses[index]);
+    Serial.println();
+  }
+}
+
+// Forget slopes and history, relaxing any fast probe (rescan, resolution change).
+// Adaptive resolutions restart from RESOLUTION; callers then set it on the bus.
+void resetTriggers() {
+  while (fastCount > 0) relaxProbe(fastCount - 1, false);
+  for (uint8_t i = 0; i < probeCount; i++) {
+    trends.slope[i] = 0;
+    memset(trends.history[i], (uint8_t)HISTORY_UNKNOWN, TRIGGER_HISTORY);
+  }
+  cyclesWithheld = 0;
+  resetAdaptive();
+}
+
+// The broadcast Convert T starts the fast probes over as well
+void restartFastClock() {
+  if (fastConverting) fastConvertMs = millis();
+}
+
+// Between poll cycles: addressed conversions on the fast probes only (9-bit
+// under TRIGGER, their own resolution under ADAPT, within its bus budget)
+void runFastSampling() {
+  // Parasite-powered probes convert on the strong pull-up, which any reset
+  // drops: addressed conversions would cut short the broadcast's and each
+  // other's, so there the fast probes only ride along with the broadcast
+  if (parasitePower) return;
+  if (fastConverting) {
+    if (millis() - fastConvertMs < (750UL >> (12 - fastResolution()))) return;
+    unsigned long busStartUs = micros();
+    for (uint8_t slot = 0; slot < fastCount; slot++) {
+      int16_t raw;
+      boolean good = readProbeRaw(fastProbes[slot], &raw) && raw >= RAW_TEMP_MIN && raw <= RAW_TEMP_MAX;
+      fastRaw[slot] = good ? raw : PROBE_NO_READING;
+    }
+    chargeBus(micros() - busStartUs);
+    fastConverting = false;
+    printFrame(true);
+  }
+  if (adaptBudget > 0 && !busAllowed()) return;
+  unsigned long busStartUs = micros();
+  for (uint8_t slot = 0; slot < fastCount; slot++) {
+    requestProbeConversion(fastProbes[slot]);
+  }
+  chargeBus(micros() - busStartUs);
+  fastConvertMs = millis();
+  fastConverting = true;
+}
+
+// ============================================================================
+// ADAPTIVE RESOLUTION
+// ============================================================================
+//
+// ADAPT:<budget> picks each probe's resolution every poll cycle from its
+// activity: the larger of |dT/dt| (the trigger's slope EWMA) and the spread
+// of its last few per-cycle deltas, both in 1/100 °C per s. A probe keeps
+// the finest resolution that moves less than one step during its own
+// conversion: 12-bit up to 0.08 °C/s, 11-bit to 0.33, 10-bit to 1.33, else
+// 9-bit. Resolution drops at once and climbs back one bit after
+// ADAPT_SETTLE_CYCLES quiet cycles. Probes below 12-bit also join the fast
+// set (up to TRIGGER_MAX_FAST) for addressed conversions between cycles.
+//
+// <budget> caps the share of time the bus is busy (reads, conversion
+// requests, resolution writes), 1-100 %: new conversions wait while the
+// measured bus time is over budget, stretching the poll cycle. Each change:
+//   [INFO] ADAPT 28ABC1230000BEEF 12->9 activity=150 bus=42% fast
+// ADAPT:0 turns it off (all probes back to RESOLUTION, TRIGGER usable again).
+
+// Finest-resolution limit in 1/100 °C per s: one step per conversion time
+int16_t adaptLimit(uint8_t bits) {
+  return (int16_t)((25L << (2 * (12 - bits))) / 3);
+}
+
+// Mean absolute deviation of the known history deltas, as a rate
+int16_t adaptSpread(uint8_t index, unsigned long cycleMs) {
+  const int8_t* history = trends.history[index];
+  int16_t sum = 0;
+  uint8_t count = 0;
+  for (uint8_t k = 0; k < TRIGGER_HISTORY; k++) {
+    if (history[k] == HISTORY_UNKNOWN) break;
+    sum += history[k];
+    count++;
+  }
+  if (count < 2 || cycleMs == 0) return 0;
+  int16_t deviation = 0;
+  for (uint8_t k = 0; k < count; k++) {
+    deviation += abs(history[k] * count - sum);  // count x |delta - mean|
+  }
+  return (int16_t)((int32_t)deviation * 6250 / ((int32_t)count * count * (int32_t)cycleMs));
+}
+
+void updateAdaptive(unsigned long cycleMs) {
+  uint8_t slowest = 9;
+  for (uint8_t i = 0; i < probeCount; i++) {
+    uint8_t bits = 9 + (trends.adapt[i] & 0x03);
+    uint8_t settle = trends.adapt[i] >> 2;
+    uint8_t from = bits;
+    int16_t activity = max((int16_t)abs(trends.slope[i]), adaptSpread(i, cycleMs));
+    
+    if (probeRaw[i] != PROBE_NO_READING) {
+      while (bits > 9 && activity > adaptLimit(bits)) bits--;
+      if (bits == from && bits < 12 && activity < adaptLimit(bits + 1) / 2) {
+        if (++settle >= ADAPT_SETTLE_CYCLES) {
+          bits++;
+          settle = 0;
+        }
+      } else {
+        settle = 0;
+      }
+    }
+    trends.adapt[i] = (settle << 2) | (bits - 9);
+    
+    // Below 12-bit: sampled between cycles too, if there is a fast slot
+    int8_t slot = fastSlot(i);
+    if (bits < 12 && slot < 0 && fastCount < TRIGGER_MAX_FAST) {
+      addFastProbe(i);
+    } else if (bits == 12 && slot >= 0) {
+      relaxProbe(slot, false);
+    } else if (bits != from) {
+      setProbeResolution(i, bits);
+    }
+    if (bits > slowest) slowest = bits;
+    
+    if (bits != from) {
+      Serial.print(F("[INFO] ADAPT "));
+      printDeviceAddress(probeAddresses[i]);
+      Serial.print(' ');
+      Serial.print(from);
+      Serial.print(F("->"));
+      Serial.print(bits);
+      Serial.print(F(" activity="));
+      Serial.print(activity);
+      Serial.print(F(" bus="));
+      Serial.print(busUtilization);
+      Serial.print('%');
+      if (fastSlot(i) >= 0) Serial.print(F(" fast"));
+      Serial.println();
+    }
+  }
+  adaptCycleBits = slowest;
+}
+
+// Bus work done outside the budget check still counts against it
+void chargeBus(unsigned long busyUs) {
+  busBusyUs += busyUs;
+  busCredit -= (long)busyUs * 100;
+}
+
+// Credit grows at <budget> % of elapsed time, up to ADAPT_BURST_MS worth
+boolean busAllowed() {
+  unsigned long now = micros();
+  // No more than a full burst can be earned, however long BENCH, CAPTURE or
+  // READ held loop(); the clamp also keeps elapsed * budget inside a long
+  unsigned long elapsedUs = min(now - busCreditUs, ADAPT_BURST_MS * 1000);
+  busCredit += (long)elapsedUs * adaptBudget;
+  busCreditUs = now;
+  if (busCredit > (long)ADAPT_BURST_MS * 1000 * 100) busCredit = (long)ADAPT_BURST_MS * 1000 * 100;
+  return busCredit >= 0;
+}
+
+// Share of time the bus was busy since the last cycle, for reports
+void measureBusUtilization() {
+  unsigned long now = micros();
+  unsigned long elapsedUs = now - busWindowUs;
+  if (elapsedUs == 0) return;
+  busUtilization = (uint8_t)min(100UL, busBusyUs * 100 / elapsedUs);
+  busBusyUs = 0;
+  busWindowUs = now;
+}
+
+// Poll cycle under ADAPT: read as soon as the slowest probe is done, start
+// the next one after POLL_INTERVAL if the budget allows
+void runAdaptivePoll(unsigned long currentTime) {
+  if (!conversionInProgress) {
+    if (currentTime - lastPollTime < POLL_INTERVAL || !busAllowed()) return;
+    unsigned long busStartUs = micros();
+    requestConversion();
+    chargeBus(micros() - busStartUs);
+    conversionInProgress = true;
+    lastPollTime = currentTime;
+    restartFastClock();
+  } else if (conversionDone(currentTime - lastPollTime, adaptCycleBits, CONVERSION_ALL)) {
+    readAndPrintTemperatures();
+    conversionInProgress = false;
+  }
+}
+
+// Back to one resolution for all (ADAPT:0, TRIGGER, RESOLUTION, rescan)
+void resetAdaptive() {
+  for (uint8_t i = 0; i < probeCount; i++) {
+    trends.adapt[i] = activeResolution - 9;
+  }
+  adaptCycleBits = activeResolution;
+  busCredit = 0;
+  busCreditUs = micros();
+}
+
+// ============================================================================
+// SCHEMA FRAMES
+// ============================================================================
+
+// One CRC-16 (0xA001) step per ROM byte
+uint16_t schemaHashAdd(uint16_t hash, const uint8_t* address) {
+  for (uint8_t i = 0; i < 8; i++) {
+    hash ^= address[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      hash = (hash & 1) ? (hash >> 1) ^ 0xA001 : hash >> 1;
+    }
+  }
+  return hash;
+}
+
+// Always 4 lowercase hex chars
+size_t printSchemaVersion(uint16_t version) {
+  static const char HEX_DIGITS[] PROGMEM = "0123456789abcdef";
+  for (int8_t shift = 12; shift >= 0; shift -= 4) {
+    Serial.print((char)pgm_read_byte(&HEX_DIGITS[(version >> shift) & 0x0F]));
+  }
+  return 4;
+}
+
+// SCHEMA:<version>:rom1,rom2,... in the order data frames use
+void printSchema() {
+  Serial.print(F("SCHEMA:"));
+  printSchemaVersion(schemaVersion);
+  Serial.print(':');
+  for (uint8_t i = 0; i < probeCount; i++) {
+    char address[17];
+    formatAddress(address, probeAddresses[i]);
+    if (i > 0) Serial.print(',');
+    Serial.print(address);
+  }
+  Serial.println();
+  framesSinceSchema = 0;
+}
+
+// ============================================================================
+// BENCH MODE (SYNTHETIC MAX-RATE FRAMES)
+// ============================================================================
+//
+// BENCH:<probes>,<hz>[,<seconds>] emits frames in the normal output format
+// for <probes> virtual probes at up to <hz> frames/sec, skipping the bus,
+// then reports what the link actually achieved. Any command ends it early.
+// Use hz=0 for "as fast as the UART allows". In schema mode the virtual
+// probes are announced with their own SCHEMA frame first.
+
+// Virtual probe ROMs: 28be4e434800xxxx
+void benchAddress(uint8_t* address, int index) {
+  static const uint8_t PREFIX[6] PROGMEM = {0x28, 0xbe, 0x4e, 0x43, 0x48, 0x00};
+  memcpy_P(address, PREFIX, 6);
+  address[6] = index >> 8;
+  address[7] = index & 0xFF;
+}
+
+void startBench(String args) {
+  int firstComma = args.indexOf(',');
+  if (firstComma < 0) {
+    beginReply(REPLY_ERROR);
+    Serial.println(F("Usage: BENCH:<probes>,<hz>[,<seconds>]"));
+    return;
+  }
+  int secondComma = args.indexOf(',', firstComma + 1);
+  int probes = args.substring(0, firstComma).toInt();
+  long hz = (secondComma < 0 ? args.substring(firstComma + 1) : args.substring(firstComma + 1, secondComma)).toInt();
+  long seconds = secondComma < 0 ? 0 : args.substring(secondComma + 1).toInt();
+  
+  if (probes < 1 || probes > BENCH_MAX_PROBES || hz < 0) {
+    beginReply(REPLY_ERROR);
+    Serial.print(F("BENCH probes must be 1-"));
+    Serial.print(BENCH_MAX_PROBES);
+    Serial.println(F(" and hz >= 0"));
+    return;
+  }
+  
+  benchProbes = probes;
+  benchIntervalUs = hz > 0 ? 1000000UL / hz : 0;
+  benchDurationMs = seconds > 0 ? seconds * 1000UL : BENCH_DURATION_MS;
+  benchFrames = 0;
+  benchBytes = 0;
+  
+  beginReply(REPLY_OK);
+  Serial.print(F("BENCH_START probes="));
+  Serial.print(benchProbes);
+  Serial.print(F(" hz="));
+  Serial.print(hz);
+  Serial.print(F(" duration_ms="));
+  Serial.println(benchDurationMs);
+  
+  if (schemaFrames) {
+    uint8_t address[8];
+    char text[17];
+    benchSchemaVersion = 0xFFFF;
+    for (int i = 0; i < benchProbes; i++) {
+      benchAddress(address, i);
+      benchSchemaVersion = schemaHashAdd(benchSchemaVersion, address);
+    }
+    Serial.print(F("SCHEMA:"));
+    printSchemaVersion(benchSchemaVersion);
+    Serial.print(':');
+    for (int i = 0; i < benchProbes; i++) {
+      benchAddress(address, i);
+      formatAddress(text, address);
+      if (i > 0) Serial.print(',');
+      Serial.print(text);
+    }
+    Serial.println();
+  }
+  Serial.flush();  // Don't count the banner
+  
+  benchActive = true;
+  benchStartMs = millis();
+  benchNextUs = micros();
+}
+
+void runBench() {
+  if (millis() - benchStartMs >= benchDurationMs) {
+    stopBench();
+    return;
+  }
+  if (benchIntervalUs > 0 && (long)(micros() - benchNextUs) < 0) {
+    return;
+  }
+  benchNextUs += benchIntervalUs;
+  
+  // Same shape as a real frame: @version/millis:21.25,... or 28be4e4348000003:21.25,...
+  size_t bytes = 0;
+  if (schemaFrames) {
+    bytes += Serial.print('@');
+    bytes += printSchemaVersion(benchSchemaVersion);
+    bytes += Serial.print('/');
+    bytes += Serial.print(millis());
+    bytes += Serial.print(':');
+  }
+  for (int i = 0; i < benchProbes; i++) {
+    if (i > 0) bytes += Serial.print(',');
+    if (!schemaFrames) {
+      uint8_t address[8];
+      char text[17];
+      benchAddress(address, i);
+      formatAddress(text, address);
+      bytes += Serial.print(text);
+      bytes += Serial.print(':');
+    }
+    
+    // 20.00..35.75 in 0.25 steps, same integer formatter as real frames
+    char value[8];
+    formatTemperature(value, (int16_t)(20 * 16 + ((benchFrames + i) % 64) * 4));
+    bytes += Serial.print(value);
+  }
+  bytes += Serial.println();
+  
+  benchFrames++;
+  benchBytes += bytes;
+}
+
+void stopBench() {
+  Serial.flush();  // Count only bytes that actually left the UART
+  unsigned long elapsedMs = millis() - benchStartMs;
+  benchActive = false;
+  if (elapsedMs == 0) elapsedMs = 1;
+  
+  Serial.print(F("[INFO] BENCH_RESULT probes="));
+  Serial.print(benchProbes);
+  Serial.print(F(" frames="));
+  Serial.print(benchFrames);
+  Serial.print(F(" bytes="));
+  Serial.print(benchBytes);
+  Serial.print(F(" elapsed_ms="));
+  Serial.print(elapsedMs);
+  // Rates with integer math only (x.yy frames/sec)
+  unsigned long scaledFrames = benchFrames * 1000UL;
+  unsigned long fpsHundredths = (scaledFrames % elapsedMs) * 100UL / elapsedMs;
+  Serial.print(F(" frames_per_s="));
+  Serial.print(scaledFrames / elapsedMs);
+  Serial.print('.');
+  if (fpsHundredths < 10) Serial.print('0');
+  Serial.print(fpsHundredths);
+  Serial.print(F(" bytes_per_s="));
+  Serial.println((benchBytes / elapsedMs) * 1000UL + (benchBytes % elapsedMs) * 1000UL / elapsedMs);
+  
+  // Resume normal polling from a clean state (and re-announce the real schema)
+  conversionInProgress = false;
+  framesSinceSchema = SCHEMA_INTERVAL;
+  lastPollTime = millis();
+}
+
+// ============================================================================
+// CAPTURE MODE (BURST CAPTURE TO SRAM)
+// ============================================================================
+//
+// CAPTURE:<i>[+<i>...][,<ms>] switches up to CAPTURE_MAX_PROBES probes
+// (schema positions) to 9-bit and converts them back to back, as fast as
+// the conversions finish. Each sweep is stored as one ring record:
+//   [ms since previous record][raw probe 1]...[raw probe n]
+// With no <ms> the capture ends when the ring is full; with <ms> it runs
+// that long keeping the newest records. Any command ends it early. The ring
+// reuses the trigger/ADAPT state, so fast probes relax and adaptive
+// resolutions restart from RESOLUTION afterwards. Then:
+//   [INFO] CAPTURE_DUMP records=80 probes=2 bits=9 start_ms=51234 overwritten=0
+//   CAPTURE_ROMS:28abc1230000beef,28def4560000cafe
+//   +0:360,352        <- ms since previous record : raw 1/16 °C counts
+//   +94:361,
+//   [INFO] CAPTURE_END
+
+void startCapture(String args) {
+  int comma = args.indexOf(',');
+  String list = comma < 0 ? args : args.substring(0, comma);
+  long durationMs = comma < 0 ? 0 : args.substring(comma + 1).toInt();
+  
+  captureCount = 0;
+  while (list.length() > 0 && captureCount < CAPTURE_MAX_PROBES) {
+    int plus = list.indexOf('+');
+    String item = plus < 0 ? list : list.substring(0, plus);
+    list = plus < 0 ? String() : list.substring(plus + 1);
+    item.trim();
+    long index = item.toInt();
+    if (item.length() == 0 || (index == 0 && !textIs(item, PSTR("0"))) || index < 0 || index >= probeCount) {
+      captureCount = 0;
+      break;
+    }
+    captureProbes[captureCount++] = index;
+  }
+  if (captureCount == 0 || list.length() > 0 || durationMs < 0) {
+    beginReply(REPLY_ERROR);
+    Serial.print(F("Usage: CAPTURE:<i>[+<i>...][,<ms>] with up to "));
+    Serial.print(CAPTURE_MAX_PROBES);
+    Serial.println(F(" probe positions"));
+    return;
+  }
+  
+  for (uint8_t i = 0; i < captureCount; i++) {
+    setProbeResolution(captureProbes[i], CAPTURE_RESOLUTION);
+  }
+  captureCapacity = CAPTURE_RING_WORDS / (1 + captureCount);
+  captureHead = 0;
+  captureStored = 0;
+  captureOverwritten = 0;
+  captureDurationMs = durationMs;
+  captureConverting = false;
+  captureActive = true;
+  captureStartMs = millis();
+  captureLastMs = captureStartMs;
+  
+  beginReply(REPLY_OK);
+  Serial.print(F("CAPTURE_START probes="));
+  Serial.print(captureCount);
+  Serial.print(F(" capacity="));
+  Serial.println(captureCapacity);
+}
+
+void runCapture() {
+  if (!captureConverting) {
+    for (uint8_t i = 0; i < captureCount; i++) {
+      requestProbeConversion(captureProbes[i]);
+    }
+    captureConvertMs = millis();
+    captureConverting = true;
+    return;
+  }
+  if (!conversionDone(millis() - captureConvertMs, CAPTURE_RESOLUTION, captureProbes[captureCount - 1])) return;
+  captureConverting = false;
+  
+  unsigned long now = millis();
+  uint8_t width = 1 + captureCount;
+  if (captureStored == 0) {
+    captureOldestMs = now;
+  } else if (captureStored == captureCapacity) {
+    // Evict the oldest record; the next one's delta moves the start forward
+    uint16_t next = (captureHead + 1) % captureCapacity;
+    captureOldestMs = captureCapacity > 1 ? captureOldestMs + (uint16_t)captureRing[next * width] : now;
+    captureOverwritten++;
+  }
+  
+  int16_t* record = captureRing + captureHead * width;
+  unsigned long delta = now - captureLastMs;
+  record[0] = (int16_t)(uint16_t)(delta > 0xFFFF ? 0xFFFF : delta);
+  for (uint8_t i = 0; i < captureCount; i++) {
+    int16_t raw;
+    record[1 + i] = readProbeRaw(captureProbes[i], &raw) ? raw : PROBE_NO_READING;
+  }
+  captureLastMs = now;
+  captureHead = (captureHead + 1) % captureCapacity;
+  if (captureStored < captureCapacity) captureStored++;
+  
+  if (captureDurationMs == 0 ? captureStored == captureCapacity : now - captureStartMs >= captureDurationMs) {
+    stopCapture();
+  }
+}
+
+void stopCapture() {
+  captureActive = false;
+  
+  Serial.print(F("[INFO] CAPTURE_DUMP records="));
+  Serial.print(captureStored);
+  Serial.print(F(" probes="));
+  Serial.print(captureCount);
+  Serial.print(F(" bits="));
+  Serial.print(CAPTURE_RESOLUTION);
+  Serial.print(F(" start_ms="));
+  Serial.print(captureOldestMs);
+  Serial.print(F(" overwritten="));
+  Serial.println(captureOverwritten);
+  
+  Serial.print(F("CAPTURE_ROMS:"));
+  for (uint8_t i = 0; i < captureCount; i++) {
+    char address[17];
+    formatAddress(address, probeAddresses[captureProbes[i]]);
+    if (i > 0) Serial.print(',');
+    Serial.print(address);
+  }
+  Serial.println();
+  
+  // Oldest first; its delta is replaced by 0 since start_ms already places it
+  uint8_t width = 1 + captureCount;
+  uint16_t slot = captureStored < captureCapacity ? 0 : captureHead;
+  for (uint16_t n = 0; n < captureStored; n++) {
+    const int16_t* record = captureRing + slot * width;
+    Serial.print('+');
+    Serial.print(n == 0 ? 0 : (uint16_t)record[0]);
+    Serial.print(':');
+    for (uint8_t i = 0; i < captureCount; i++) {
+      if (i > 0) Serial.print(',');
+      if (record[1 + i] != PROBE_NO_READING) Serial.print(record[1 + i]);
+    }
+    Serial.println();
+    slot = (slot + 1) % captureCapacity;
+  }
+  Serial.println(F("[INFO] CAPTURE_END"));
+  
+  // Resume normal polling from a clean state. The ring overwrote the
+  // trigger/ADAPT state, so that starts over as after a rescan.
+  resetTriggers();
+  if (adaptBudget > 0) {
+    setAllResolution(activeResolution);
+  } else {
+    for (uint8_t i = 0; i < captureCount; i++) {
+      setProbeResolution(captureProbes[i], activeResolution);
+    }
+  }
+  conversionInProgress = false;
+  lastPollTime = millis();
+}
+
+// ============================================================================
+// SINGLE-PROBE READ (READ COMMAND)
+// ============================================================================
+//
+// READ:<rom>[,<bits>] converts one probe on its own (MATCH ROM, 9-bit by
+// default, ~94 ms) ahead of the poll schedule and answers as soon as it is
+// read:
+//   [INFO] READ 28abc1230000beef 23.50 bits=9 conv_ms=95 latency_ms=97
+// latency_ms runs from the command to the reading, conv_ms is the
+// conversion alone. A bus-wide conversion already running is finished and
+// sent first; the schedule then waits for the read. Commands sent meanwhile
+// stay queued (TIME pings are still answered).
+
+// Which probe position, or -1 (rom is 16 hex chars, any case)
+int8_t findProbe(String rom) {
+  if (rom.length() != 16) return -1;
+  rom.toLowerCase();
+  for (uint8_t i = 0; i < probeCount; i++) {
+    char address[17];
+    formatAddress(address, probeAddresses[i]);
+    if (rom == address) return i;
+  }
+  return -1;
+}
+
+void startSingleRead(String args) {
+  int comma = args.indexOf(',');
+  long bits = comma < 0 ? READ_RESOLUTION : args.substring(comma + 1).toInt();
+  int8_t index = findProbe(comma < 0 ? args : args.substring(0, comma));
+  if (index < 0 || bits < 9 || bits > 12) {
+    beginReply(REPLY_ERROR);
+    Serial.println(index < 0 ? F("READ: unknown probe") : F("Usage: READ:<rom>[,<9-12>]"));
+    return;
+  }
+  
+  readIndex = index;
+  readBits = bits;
+  readTag = commandTag;
+  commandReplied = true;  // The reply comes from finishSingleRead()
+  readRequestMs = millis();
+  readPending = true;
+}
+
+void runSingleRead() {
+  if (readPending) {
+    // Let the bus go idle: a running poll cycle is read and sent early,
+    // fast-probe conversions are left to finish
+    if (conversionInProgress) {
+      uint8_t pollBits = adaptBudget > 0 ? adaptCycleBits : activeResolution;
+      if (!conversionDone(millis() - lastPollTime, pollBits, CONVERSION_ALL)) return;
+      readAndPrintTemperatures();
+      conversionInProgress = false;
+    }
+    if (fastConverting) {
+      uint8_t lastFast = fastCount > 0 ? fastProbes[fastCount - 1] : CONVERSION_NONE;
+      if (!conversionDone(millis() - fastConvertMs, fastResolution(), lastFast)) return;
+    }
+    
+    if (readBits != scheduledResolution(readIndex)) setProbeResolution(readIndex, readBits);
+    requestProbeConversion(readIndex);
+    readConvertMs = millis();
+    readPending = false;
+    readConverting = true;
+    return;
+  }
+  
+  unsigned long convMs = millis() - readConvertMs;
+  if (!conversionDone(convMs, readBits, readIndex)) return;
+  int16_t raw;
+  boolean good = readProbeRaw(readIndex, &raw) && raw >= RAW_TEMP_MIN && raw <= RAW_TEMP_MAX;
+  unsigned long latencyMs = millis() - readRequestMs;
+  readConverting = false;
+  if (readBits != scheduledResolution(readIndex)) setProbeResolution(readIndex, scheduledResolution(readIndex));
+  
+  char address[17];
+  formatAddress(address, probeAddresses[readIndex]);
+  commandTag = readTag;
+  beginReply(good ? REPLY_OK : REPLY_ERROR);
+  Serial.print(F("READ "));
+  Serial.print(address);
+  if (good) {
+    char value[8];
+    formatTemperature(value, raw);
+    Serial.print(' ');
+    Serial.print(value);
+  } else {
+    Serial.print(F(" failed"));
+  }
+  Serial.print(F(" bits="));
+  Serial.print(readBits);
+  Serial.print(F(" conv_ms="));
+  Serial.print(convMs);
+  Serial.print(F(" latency_ms="));
+  Serial.println(latencyMs);
+  commandTag = -1;
+}
+
+// ============================================================================
+// UTILITY: INTEGER-ONLY FORMATTING FOR FRAMES
+// ============================================================================
+
+// Write the 16 lowercase hex chars of a ROM (same text the old String(b, HEX) loop built)
+uint8_t formatAddress(char* out, const uint8_t* deviceAddress) {
+  static const char HEX_DIGITS[] PROGMEM = "0123456789abcdef";
+  for (uint8_t i = 0; i < 8; i++) {
+    out[2 * i] = pgm_read_byte(&HEX_DIGITS[deviceAddress[i] >> 4]);
+    out[2 * i + 1] = pgm_read_byte(&HEX_DIGITS[deviceAddress[i] & 0x0F]);
+  }
+  out[16] = '\0';
+  return 16;
+}
+
+// Write raw 1/16 °C counts as "-12.34" (2 decimals, as String(float, 2) did).
+// Exact ties (x.xx5, 11/12-bit only) round half up, where the old float path
+// went either way depending on magnitude. Needs 8 bytes.
+uint8_t formatTemperature(char* out, int16_t raw) {
+  uint8_t length = 0;
+  uint16_t magnitude = raw;
+  if (raw < 0) {
+    out[length++] = '-';
+    magnitude = -raw;
+  }
+  
+  // 1/16 °C = 6.25 hundredths; +2 rounds half up
+  uint16_t centi = (uint16_t)(((uint32_t)magnitude * 25 + 2) / 4);
+  uint16_t whole = centi / 100;
+  uint8_t fraction = centi % 100;
+  
+  char digits[4];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + whole % 10;
+    whole /= 10;
+  } while (whole > 0);
+  while (count > 0) out[length++] = digits[--count];
+  
+  out[length++] = '.';
+  out[length++] = '0' + fraction / 10;
+  out[length++] = '0' + fraction % 10;
+  out[length] = '\0';
+  return length;
+}
+
+// ============================================================================
+// UTILITY: PRINT DEVICE ADDRESS (FOR DEBUG)
+// ============================================================================
+
+void printDeviceAddress(const uint8_t* deviceAddress) {
+  for (uint8_t i = 0; i < 8; i++) {
+    if (deviceAddress[i] < 16) Serial.print(F("0"));
+    Serial.print(deviceAddress[i], HEX);
+  }
+}
+
+// ============================================================================
+// SERIAL COMMAND HANDLING (RESCAN, RESOLUTION CHANGE, etc.)
+// ============================================================================
+
+// Move received bytes into the command queue. Called every loop pass and
+// between probe reads, so pipelined commands don't overflow the 64-byte UART
+// buffer while a long frame is being read. TIME pings are answered here, as
+// soon as their line is complete, to keep the host's clock fit tight. While
+// the queue is full, bytes wait in the UART buffer.
+void pollSerial() {
+  while (commandQueueCount < COMMAND_QUEUE_DEPTH && Serial.available()) {
+    uint8_t slot = (commandQueueHead + commandQueueCount) % COMMAND_QUEUE_DEPTH;
+    char* line = commandQueue[slot];
+    char c = Serial.read();
+    if (c == '\r') continue;
+    if (c != '\n') {
+      if (commandLength < COMMAND_MAX_LENGTH) {
+        line[commandLength++] = c;
+      } else {
+        commandTruncated |= 1 << slot;
+      }
+      continue;
+    }
+    
+    line[commandLength] = '\0';
+    commandLength = 0;
+    boolean truncated = commandTruncated & (1 << slot);
+    if (!truncated && strncmp_P(line, PSTR("TIME:"), 5) == 0) {
+      // Clock ping-pong: "TIME:<token>" -> "TIME:<token>:<millis>"
+      Serial.print(line);
+      Serial.print(':');
+      Serial.println(millis());
+      continue;
+    }
+    if (line[0] != '\0' || truncated) commandQueueCount++;
+  }
+}
+
+// Command names and arguments are compared against PSTR() literals in flash;
+// String == "..." would keep a copy of every name in SRAM
+boolean textIs(const String& text, PGM_P name) {
+  return strcmp_P(text.c_str(), name) == 0;
+}
+
+boolean textStarts(const String& text, PGM_P prefix) {
+  return strncmp_P(text.c_str(), prefix, strlen_P(prefix)) == 0;
+}
+
+// Start a reply line for the command being run. Tagged commands get
+// "#<id> OK ", "#<id> ERR " or "#<id> - " (one line of a longer reply);
+// untagged ones the usual [INFO] / [ERROR] / [WARN] prefix.
+void beginReply(uint8_t kind) {
+  if (commandTag < 0) {
+    Serial.print(kind == REPLY_ERROR ? F("[ERROR] ") : kind == REPLY_WARN ? F("[WARN] ") : F("[INFO] "));
+    return;
+  }
+  Serial.print('#');
+  Serial.print(commandTag);
+  Serial.print(kind == REPLY_MORE ? F(" - ") : kind == REPLY_OK ? F(" OK ") : F(" ERR "));
+  if (kind != REPLY_MORE) commandReplied = true;
+}
+
+// Run the oldest queued command; one per loop pass, so frames keep flowing
+// between pipelined commands. "#<id> CMD" tags a command: it then ends with
+// exactly one "#<id> OK ..." or "#<id> ERR ..." line ("#<id> OK" when the
+// command has nothing else to say).
+void handleSerialCommands() {
+  pollSerial();
+  if (commandQueueCount == 0) return;
+  
+  uint8_t slot = commandQueueHead;
+  String command = commandQueue[slot];
+  boolean truncated = commandTruncated & (1 << slot);
+  commandTruncated &= ~(1 << slot);
+  commandQueueHead = (commandQueueHead + 1) % COMMAND_QUEUE_DEPTH;
+  commandQueueCount--;
+  command.trim();
+  
+  commandTag = -1;
+  if (command.charAt(0) == '#') {
+    int space = command.indexOf(' ');
+    String id = space < 0 ? command.substring(1) : command.substring(1, space);
+    long tag = id.toInt();
+    if (id.length() == 0 || id.length() > 5 || (tag == 0 && !textIs(id, PSTR("0"))) || tag < 0 || tag > 65535) {
+      Serial.print(F("[ERROR] Bad command tag: "));
+      Serial.println(command);
+      return;
+    }
+    commandTag = tag;
+    command = space < 0 ? String() : command.substring(space + 1);
+    command.trim();
+  }
+  
+  commandReplied = false;
+  if (truncated) {
+    beginReply(REPLY_ERROR);
+    Serial.print(F("Command longer than "));
+    Serial.println(COMMAND_MAX_LENGTH);
+  } else {
+    runCommand(command);
+  }
+  if (commandTag >= 0 && !commandReplied) {
+    Serial.print('#');
+    Serial.print(commandTag);
+    Serial.println(F(" OK"));
+  }
+  commandTag = -1;
+}
+
+void runCommand(String command) {
+  // Any command ends a running benchmark or capture
+  if (benchActive) {
+    stopBench();
+    if (textIs(command, PSTR("BENCH:STOP"))) return;
+  }
+  if (captureActive) {
+    stopCapture();
+    if (textIs(command, PSTR("CAPTURE:STOP"))) return;
+  }
+  
+  if (textStarts(command, PSTR("BENCH:"))) {
+    // Example: "BENCH:16,20" = 16 virtual probes at 20 frames/sec for 10s
+    startBench(command.substring(6));
+  }
+  else if (textStarts(command, PSTR("CAPTURE:"))) {
+    // Example: "CAPTURE:0+2,5000" = probes 0 and 2 at 9-bit, newest 5s kept
+    startCapture(command.substring(8));
+  }
+  else if (textStarts(command, PSTR("READ:"))) {
+    // Example: "READ:28abc1230000beef,12" = that probe alone at 12-bit, now
+    startSingleRead(command.substring(5));
+  }
+  else if (textIs(command, PSTR("RESCAN"))) {
+    // Rescan for sensors (useful if hot-swapping); new ones get the current resolution
+    scanProbes();
+    setAllResolution(activeResolution);
+    beginReply(REPLY_OK);
+    Serial.print(F("RESCAN_COMPLETE Found "));
+    Serial.print(probeCount);
+    Serial.println(F(" sensors"));
+  } 
+  else if (textStarts(command, PSTR("RESOLUTION:"))) {
+    // Change resolution on the fly
+    // Example: "RESOLUTION:11" sets all sensors to 11-bit
+    int newResolution = command.substring(11).toInt();
+    if (newResolution >= 9 && newResolution <= 12) {
+      activeResolution = newResolution;
+      resetTriggers();
+      setAllResolution(activeResolution);
+      beginReply(REPLY_OK);
+      Serial.print(F("Resolution changed to "));
+      Serial.print(newResolution);
+      Serial.println(F("-bit"));
+    } else {
+      beginReply(REPLY_ERROR);
+      Serial.println(F("Resolution must be 9, 10, 11, or 12"));
+    }
+  }
+  else if (textStarts(command, PSTR("TRIGGER:"))) {
+    // Example: "TRIGGER:50,4" = fast mode above 0.50 °C/s, steady frames every 4th cycle
+    String args = command.substring(8);
+    int comma = args.indexOf(',');
+    long threshold = (comma < 0 ? args : args.substring(0, comma)).toInt();
+    long every = comma < 0 ? 1 : args.substring(comma + 1).toInt();
+    if (threshold >= 0 && threshold <= 30000 && every >= 1 && every <= TRIGGER_HISTORY + 1) {
+      boolean wasAdaptive = adaptBudget > 0;  // TRIGGER and ADAPT share the fast set
+      adaptBudget = 0;
+      resetTriggers();
+      if (wasAdaptive) setAllResolution(activeResolution);
+      triggerThreshold = threshold;
+      relaxedEvery = threshold > 0 ? every : 1;
+      beginReply(REPLY_OK);
+      Serial.print(F("Trigger "));
+      Serial.print(triggerThreshold);
+      Serial.print(F(" (1/100 C/s), steady frames every "));
+      Serial.println(relaxedEvery);
+    } else {
+      beginReply(REPLY_ERROR);
+      Serial.print(F("Usage: TRIGGER:<0-30000>[,<1-"));
+      Serial.print(TRIGGER_HISTORY + 1);
+      Serial.println(F(">]"));
+    }
+  }
+  else if (textStarts(command, PSTR("ADAPT:"))) {
+    // Example: "ADAPT:40" = per-probe resolution, bus busy at most 40% of the time; "ADAPT:0" = off
+    String args = command.substring(6);
+    long budget = args.toInt();
+    if (budget >= 0 && budget <= 100 && (budget > 0 || textIs(args, PSTR("0")))) {
+      adaptBudget = budget;
+      resetTriggers();
+      setAllResolution(activeResolution);
+      triggerThreshold = 0;
+      relaxedEvery = 1;
+      beginReply(REPLY_OK);
+      if (adaptBudget > 0) {
+        Serial.print(F("Adaptive resolution, bus budget "));
+        Serial.print(adaptBudget);
+        Serial.println('%');
+      } else {
+        Serial.println(F("Adaptive resolution off"));
+      }
+    } else {
+      beginReply(REPLY_ERROR);
+      Serial.println(F("Usage: ADAPT:<0-100>"));
+    }
+  }
+  else if (textIs(command, PSTR("SCHEMA"))) {
+    // Host saw a schema version it doesn't know
+    printSchema();
+  }
+  else if (textStarts(command, PSTR("FORMAT:"))) {
+    // "FORMAT:SCHEMA" = positional frames (default), "FORMAT:FULL" = ID:temp frames
+    String format = command.substring(7);
+    if (textIs(format, PSTR("SCHEMA")) || textIs(format, PSTR("FULL"))) {
+      schemaFrames = textIs(format, PSTR("SCHEMA"));
+      framesSinceSchema = SCHEMA_INTERVAL;
+      beginReply(REPLY_OK);
+      Serial.print(F("Frame format "));
+      Serial.println(format);
+    } else {
+      beginReply(REPLY_ERROR);
+      Serial.println(F("Format must be SCHEMA or FULL"));
+    }
+  }
+  else if (textIs(command, PSTR("PROBES"))) {
+    // One line per probe with its read mode
+    // Example: "[INFO] PROBE 0 28be4e4348000003 mode=partial"
+    for (uint8_t i = 0; i < probeCount; i++) {
+      char address[17];
+      formatAddress(address, probeAddresses[i]);
+      beginReply(REPLY_MORE);
+      Serial.print(F("PROBE "));
+      Serial.print(i);
+      Serial.print(' ');
+      Serial.print(address);
+      Serial.print(F(" mode="));
+      Serial.print(usesPartialRead(i) ? F("partial") : F("full"));
+      Serial.print(F(" bits="));
+      Serial.print(scheduledResolution(i));
+      Serial.print(F(" slope="));
+      Serial.print(trends.slope[i]);
+      if (fastSlot(i) >= 0) Serial.print(F(" fast"));
+#if USE_LEAN_DRIVER
+      Serial.print(F(" owed="));
+      Serial.print(errorScore(i));
+#endif
+      Serial.println();
+    }
+    beginReply(REPLY_OK);
+    Serial.print(F("PROBES_COMPLETE "));
+    Serial.println(probeCount);
+  }
+  else if (textIs(command, PSTR("STATUS"))) {
+    // Return status info
+    beginReply(REPLY_OK);
+    Serial.print(F("Sensors: "));
+    Serial.print(probeCount);
+    Serial.print(F(" | Resolution: "));
+    Serial.print(activeResolution);
+    Serial.print(F("-bit | Poll interval: "));
+    Serial.print(POLL_INTERVAL);
+    Serial.print(F("ms | Format: "));
+    Serial.print(schemaFrames ? F("SCHEMA") : F("FULL"));
+    Serial.print(F(" | Trigger: "));
+    Serial.print(triggerThreshold);
+    Serial.print(F(" ("));
+    Serial.print(fastCount);
+    Serial.print(F(" fast) | Adapt: "));
+    Serial.print(adaptBudget);
+    Serial.print(F("% | Bus: "));
+    Serial.print(busUtilization);
+    Serial.println('%');
+  }
+  else if (command.length() > 0) {
+    // Unknown command
+    beginReply(REPLY_WARN);
+    Serial.print(F("Unknown command: "));
+    Serial.println(command);
+  }
+}
+
+// ============================================================================
+// NOTES FOR RASPBERRY PI COMPATIBILITY
+// ============================================================================
+//
+// OUTPUT FORMAT (default FORMAT:SCHEMA):
+// ✅ "SCHEMA:<version>:<rom>,<rom>" before the first frame, when the ROM set
+//    changes, every SCHEMA_INTERVAL frames and on a SCHEMA request
+// ✅ "@<version>/<millis>:23.45,,22.10" - positional, in schema order, an
+//    empty field for a failed read; a host that sees an unknown <version>
+//    sends SCHEMA and drops frames until it has the ROM list
+// ✅ Temperature in Celsius, 2 decimal places
+// ✅ Serial baud: 9600 (standard)
+//
+// LEGACY FORMAT (FORMAT:FULL):
+// ✅ "28abc123:23.45,28def456:22.10" - colon between ROM and temperature,
+//    failed reads left out; for hosts that predate schema frames
+//
+// OTHER LINES:
+// ✅ Info/error messages prefixed with [INFO], [ERROR], [WARN]
+// ✅ TRIG:, CAPTURE_ROMS:, "+<ms>:" capture records and TIME replies are
+//    not frames; a host must not parse them as readings
+// ✅ Commands may be tagged: "#7 CMD" is answered "#7 OK ..." or "#7 ERR ...",
+//    with "#7 - ..." for the lines of a multi-line reply
+//
+// HOST SIDE (RPi/app_heat.py):
+// ✅ Decodes both formats; asks for SCHEMA on an unknown version
+// ✅ Tags its commands and matches replies by tag
+// ✅ Keeps sensor names by ROM, so renaming and graphs follow a probe
+//    across rescans and position changes
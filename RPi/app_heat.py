@@ -1,17 +1,35 @@
 # Temperature Monitoring System - Flask Backend (v6.6 - WITH HEATER STATE)
-# The heating_control.py program should write heater data to: /tmp/heater_thermistor.json
-# JSON format: {"temperature_c": 25.5, "heater_state": "On", "timestamp": 1234567890.123}
+# The heating_control.py program should push heater data as JSON datagrams to the
+# Unix socket /tmp/heater_thermistor.sock:
+#     sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+#     sock.sendto(json.dumps(state).encode(), "/tmp/heater_thermistor.sock")
+# (Legacy: writing the same JSON to /tmp/heater_thermistor.json still works.)
+# JSON format: {"temperature_c": 25.5, "heater_state": "On", "pid_output": 0.42, "timestamp": 1234567890.123}
 
 import os
+import glob
 import json
+import math
+import atexit
+import ctypes
+import mmap
+import grp
+import re
+import struct
+import selectors
 import serial
+import signal
+import socket
+import sys
 import threading
 import time
-from datetime import datetime
+from bisect import bisect_right
+from datetime import datetime, timedelta
 from pathlib import Path
 from enum import Enum
 from queue import Queue
-from flask import Flask, render_template, jsonify, request, send_file
+from collections import deque
+from flask import Flask, Response, render_template, jsonify, request
 from functools import wraps
 
 # ============================================================================
@@ -19,30 +37,141 @@ from functools import wraps
 # ============================================================================
 # Config
 SERIAL_PORT = "/dev/ttyACM0"
+# Globs of extra controller ttys to attach as they appear (comma-separated, e.g. "/dev/ttyACM*").
+# Opt-in: every matching port is sent RESCAN/TIME/SCHEMA, so list only ports wired to Arduinos.
+SERIAL_PORT_PATTERNS = [p.strip() for p in os.environ.get("TEMPMON_SERIAL_PATTERNS", "").split(",") if p.strip()]
+SERIAL_SCAN_INTERVAL = 2.0  # Seconds between scans for new ttys
 SERIAL_BAUDRATE = 9600
+LATEST_TABLE_PATH = "/dev/shm/tempmon_latest"  # Shared-memory latest-value table
+LATEST_TABLE_SLOTS = 64
+NATIVE_LIB_PATH = os.environ.get("TEMPMON_NATIVE_LIB",
+	str(Path(__file__).resolve().parent / "native" / "libtempmon.so"))  # Built with: make -C RPi/native
 LOG_FOLDER = "/home/vbio/GC_Test/temperatureMonitor/RPi/temperature_logs"
+HEATER_SOCKET_PATH = "/tmp/heater_thermistor.sock"  # Push channel from heating_control.py
+HEATER_PUSH_STALE = 10  # Seconds before a pushed heater value is 'cached' and the JSON file is polled again
+HEATER_SOCKET_GROUP = os.environ.get("TEMPMON_HEATER_GROUP", "")  # Group allowed to push (socket is 0660); empty = our own group
+SESSION_INDEX_STRIDE = 50  # Rows between entries in each session's .idx sidecar
+ARCHIVE_CHUNK_ROWS = 1024  # Rows per chunk of a compressed session archive (.tmc)
+ROLLUP_TIERS = (60, 3600)  # Bucket seconds of each session's rollup tiers (.r60, .r3600 sidecars)
+HEATER_COLUMNS = ["Heater Thermistor (°C)", "Heater State", "PID Output"]
+LOG_COMMIT_INTERVAL = 2.0  # Seconds between group commits (flush + fsync) of session rows; 0 = every row
+SCHEMA_REQUEST_INTERVAL = 5  # Min seconds between SCHEMA requests to one controller
+TIME_SYNC_INTERVAL = 30  # Seconds between TIME ping-pongs once a controller's clock is locked
+TIME_SYNC_FAST_INTERVAL = 2  # ... and while it is still collecting its first samples
+TIME_SYNC_WINDOW = 32  # TIME samples kept per controller for the offset/skew fit
+TIME_SYNC_MAX_SKEW = 0.02  # Reject fits beyond ±2% (ceramic resonators are ~0.5%)
+COMMAND_WINDOW = 4  # Tagged commands in flight per controller (firmware COMMAND_QUEUE_DEPTH)
+COMMAND_TIMEOUT = 5  # Seconds before an unanswered tagged command is given up
+STATS_WINDOWS = (60, 600, 3600)  # Sliding windows (seconds) for per-probe mean/stddev/slope/min/max
+STATS_CAPACITY = 16384  # Samples kept per probe; a window needing more reports a shorter span
+STATS_EWMA_TAU = 30  # Time constant (seconds) of the per-probe EWMA
+STATS_MAX_PROBES = 128  # Probes with rolling statistics; 256 KiB each once STATS_CAPACITY samples are in, 640 KiB worst case (min/max queues on a steady ramp)
+ALERT_RULES_PATH = str(Path(LOG_FOLDER).parent / "alert_rules.json")  # Saved by POST /api/alerts/rules
+ALERT_SLOPE_TAU = 20  # Smoothing (seconds) of the dT/dt that slope rules compare
+ALERT_HYSTERESIS = 0.25  # Default margin (rule units) before a raised alert clears
+ALERT_QUEUE_SIZE = 256  # Alert events buffered between reader-loop drains
+ALERT_EVENT_HISTORY = 200  # Recent alert events kept for /api/alerts
+ALERT_TICK_INTERVAL = 1.0  # Seconds between staleness checks
+DISCONNECT_TIMEOUT = 30  # Seconds without a reading before a probe is marked offline
+STALE_TICK = 0.1  # Resolution (seconds) of the offline-deadline timer wheel
+STALE_TIMER_SLOTS = 256  # Probes the timer wheel can track
+PID_CONFIG_PATH = str(Path(LOG_FOLDER).parent / "pid_config.json")  # Saved by POST /api/pid
+HEATER_GPIO_PATH = os.environ.get("TEMPMON_HEATER_GPIO", "")  # File taking "1"/"0" for the in-process PID; empty = dry run
+PID_DEFAULTS = {
+	"enabled": False,
+	"sensor_id": "",  # Feedback probe
+	"setpoint": 40.0,  # °C
+	"kp": 0.2,  # Output per °C of error
+	"ki": 0.005,  # Output per °C·s
+	"kd": 1.0,  # Output per °C/s (on the measurement)
+	"derivative_tau": 2.0,  # Seconds of low-pass on the D term
+	"out_min": 0.0,
+	"out_max": 1.0,
+	"period": 0.5,  # Seconds between PID ticks
+	"window": 5.0,  # Seconds over which the on/off heater is time-proportioned
+	"feedback_timeout": 10.0  # Heater held off once the probe is silent this long
+}
 
 class HeaterThermistorReader:
 	"""
-	Reads heater thermistor temperature AND STATE from a JSON file written by heating_control.py
+	Latest heater thermistor temperature, STATE and PID output from heating_control.py.
+	Preferred: the controller pushes JSON datagrams to HEATER_SOCKET_PATH; a listener
+	thread keeps the newest one in memory, so get_temperature() does no file I/O and
+	takes no lock. Until the first datagram arrives, or once the pushed value is older
+	than HEATER_PUSH_STALE (pusher stopped), the legacy JSON file is polled. Only our
+	user and HEATER_SOCKET_GROUP may push, since the values go into the session log.
 	File format: {"temperature_c": 25.5, "heater_state": "On", "timestamp": 1234567890.123}
 	"""
-	def __init__(self, temp_file="/tmp/heater_thermistor.json"):
+	def __init__(self, temp_file="/tmp/heater_thermistor.json", socket_path=HEATER_SOCKET_PATH):
 		self.temp_file = Path(temp_file)
+		self.socket_path = socket_path
+		self.sock = None
+		self.pushed = None  # Latest pushed reading; replaced whole, never mutated
+		self.push_count = 0
 		self.last_temp = None
 		self.last_state = None
 		self.last_timestamp = None
 		self.last_pid_output = None
 		self.lock = threading.Lock()
 	
+	def start_listener(self):
+		"""Bind the push socket and start receiving heater datagrams"""
+		try:
+			if os.path.exists(self.socket_path):
+				os.unlink(self.socket_path)
+			self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+			self.sock.bind(self.socket_path)
+			if HEATER_SOCKET_GROUP:
+				os.chown(self.socket_path, -1, grp.getgrnam(HEATER_SOCKET_GROUP).gr_gid)
+			os.chmod(self.socket_path, 0o660)
+		except (OSError, KeyError) as e:
+			print(f"[HEATER] Push channel unavailable ({e}); polling {self.temp_file}")
+			self.sock = None
+			return False
+		
+		threading.Thread(target=self._listen, daemon=True).start()
+		print(f"[HEATER] Listening for heater state on {self.socket_path}")
+		return True
+	
+	def _listen(self):
+		"""Receive loop: keep only the newest valid datagram"""
+		while True:
+			try:
+				data = json.loads(self.sock.recv(4096))
+				temp = data.get('temperature_c')
+				if temp is None:
+					continue
+				self.pushed = {
+					'temperature': temp,
+					'heater_state': data.get('heater_state', 'Unknown'),
+					'pid_output': data.get('pid_output'),
+					'received': time.time()
+				}
+				self.push_count += 1
+			except (ValueError, AttributeError) as e:
+				print(f"[HEATER] Ignoring malformed heater datagram: {e}")
+			except OSError as e:
+				print(f"[HEATER] Push channel closed: {e}")
+				return
+	
 	def get_temperature(self):
 		"""
 		Read latest heater thermistor temperature AND STATE
 		Returns: dict with 'temperature', 'heater_state','pid_output' and 'status', or None if unavailable
 		"""
+		pushed = self.pushed
+		if pushed is not None and time.time() - pushed['received'] < HEATER_PUSH_STALE:
+			return {
+				'temperature': pushed['temperature'],
+				'heater_state': pushed['heater_state'],
+				'pid_output': pushed['pid_output'],
+				'status': 'online'
+			}
+		
 		with self.lock:
 			try:
-				if self.temp_file.exists():
+				# A stale push falls back to the file, if it was written after the last datagram
+				if self.temp_file.exists() and (pushed is None or self.temp_file.stat().st_mtime > pushed['received']):
 					with open(self.temp_file, 'r') as f:
 						data = json.load(f)
 						temp = data.get('temperature_c')
@@ -62,6 +191,13 @@ class HeaterThermistorReader:
 							}
 				
 				# If file doesn't exist or no valid data, return last known or None
+				if pushed is not None and (self.last_timestamp is None or pushed['received'] >= self.last_timestamp):
+					return {
+						'temperature': pushed['temperature'],
+						'heater_state': pushed['heater_state'],
+						'pid_output': pushed['pid_output'],
+						'status': 'cached'
+					}
 				if self.last_temp is not None:
 					return {
 						'temperature': self.last_temp,
@@ -107,7 +243,7 @@ class SerialMessageQueue:
 		self.max_messages = max_messages
 		self.lock = threading.Lock()
 	
-	def add(self, message, msg_type="info", timestamp=None):
+	def add(self, message, msg_type="info", timestamp=None, controller=None):
 		"""
 		Add message with type classification
 		msg_type options:
@@ -116,12 +252,14 @@ class SerialMessageQueue:
 		- "warning": Warning messages (OFFLINE, etc)
 		- "error": Error messages (CRC_FAILED, etc)
 		- "unknown": Could not classify
+		controller: tty name of the Arduino the message came from, if any
 		"""
 		with self.lock:
 			self.messages.append({
 				"timestamp": timestamp or time.time(),
 				"message": message,
-				"type": msg_type
+				"type": msg_type,
+				"controller": controller
 			})
 			
 			# Keep only last N messages to prevent memory bloat
@@ -196,50 +334,162 @@ class TemperatureSystemStateMachine:
 
 class SerialHandler:
 	"""
-	Handles serial communication with Arduino.
+	Handles serial communication with one or more Arduinos.
+	All attached controllers are multiplexed through a single selector (epoll
+	on Linux) in the caller's thread; new ttys matching port_patterns are
+	attached automatically as they appear. Every line is tagged with the
+	controller (tty name) it came from. self.lock guards the port table and
+	every write, so Flask threads, the command window and clock pings never
+	interleave bytes on a port or write to one being detached.
 	Supports both real and mock sensor modes for testing.
 	"""
-	def __init__(self, port="/dev/ttyACM0", baudrate=9600, use_mock=False):
+	def __init__(self, port=SERIAL_PORT, baudrate=SERIAL_BAUDRATE, use_mock=False, port_patterns=SERIAL_PORT_PATTERNS):
 		self.port = port
+		self.port_patterns = port_patterns
 		self.baudrate = baudrate
 		self.use_mock = use_mock
-		self.ser = None
+		self.ports = {}  # device path -> serial.Serial
+		self.buffers = {}  # device path -> partial line bytes
+		self.pending = deque()  # (controller, line, arrival time) in arrival order
+		self.last_received = None  # Arrival time of the line read_tagged() last returned
+		self.selector = selectors.DefaultSelector()
+		self.last_scan = 0
 		self.is_connected = False
 		self.mock_counter = 0
-		self.lock = threading.Lock()
+		self.lock = threading.RLock()
 	
 	def connect(self):
-		"""Attempt to connect to Arduino"""
+		"""Attempt to connect to every available Arduino"""
 		try:
 			if self.use_mock:
 				self.is_connected = True
 				print("[SERIAL] Mock mode enabled")
 				return True
 			
-			self.ser = serial.Serial(self.port, self.baudrate, timeout=1)
-			self.is_connected = True
-			print(f"[SERIAL] Connected to {self.port} at {self.baudrate} baud")
-			time.sleep(2)
-			return True
+			self._scan_ports()
+			self.is_connected = bool(self.ports)
+			return self.is_connected
 		except Exception as e:
 			print(f"[SERIAL] Connection failed: {e}")
 			self.is_connected = False
 			return False
 	
+	def _scan_ports(self):
+		"""Attach any new tty that matches the configured port/patterns"""
+		self.last_scan = time.time()
+		candidates = {self.port} if self.port else set()
+		for pattern in self.port_patterns:
+			candidates.update(glob.glob(pattern))
+		
+		with self.lock:
+			for device in sorted(candidates - set(self.ports)):
+				if not os.path.exists(device):
+					continue
+				try:
+					ser = serial.Serial(device, self.baudrate, timeout=0)
+				except Exception as e:
+					print(f"[SERIAL] Could not open {device}: {e}")
+					continue
+				self.ports[device] = ser
+				self.buffers[device] = b""
+				self.selector.register(ser.fileno(), selectors.EVENT_READ, device)
+				print(f"[SERIAL] Connected to {device} at {self.baudrate} baud")
+	
+	def _detach(self, device):
+		"""Drop a controller that went away (unplugged, reset, I/O error)"""
+		with self.lock:
+			ser = self.ports.pop(device, None)
+			self.buffers.pop(device, None)
+			if ser:
+				try:
+					self.selector.unregister(ser.fileno())
+				except (KeyError, ValueError):
+					pass
+				try:
+					ser.close()
+				except Exception:
+					pass
+				print(f"[SERIAL] Detached {device}")
+			self.is_connected = bool(self.ports)
+	
+	def _drain(self, device):
+		"""Read whatever is waiting on one port and queue complete lines"""
+		with self.lock:
+			ser = self.ports.get(device)
+			if not ser:
+				return  # Detached by a writer since select() returned
+			try:
+				chunk = ser.read(ser.in_waiting or 1)
+			except Exception as e:
+				print(f"[SERIAL] Read error on {device}: {e}")
+				self._detach(device)
+				return
+			received = time.time()
+			*lines, self.buffers[device] = (self.buffers[device] + chunk).split(b"\n")
+		
+		controller = os.path.basename(device)
+		for raw in lines:
+			line = raw.decode('utf-8', 'replace').strip()
+			if line:
+				self.pending.append((controller, line, received))
+	
+	def read_tagged(self, timeout=0.1):
+		"""
+		Return the next (controller, line) from any attached Arduino (or mock
+		data), waiting up to timeout seconds. Returns (None, None) if idle.
+		The time the line came off the tty is left in self.last_received.
+		"""
+		if self.use_mock:
+			self.last_received = time.time()
+			return "mock", self._generate_mock_data()
+		
+		if time.time() - self.last_scan >= SERIAL_SCAN_INTERVAL:
+			self._scan_ports()
+		
+		if not self.pending:
+			try:
+				events = self.selector.select(timeout)
+			except OSError as e:
+				print(f"[SERIAL] Select error: {e}")
+				events = []
+			for key, _ in events:
+				self._drain(key.data)
+		
+		if self.pending:
+			controller, line, self.last_received = self.pending.popleft()
+			return controller, line
+		return None, None
+	
 	def read_line(self):
-		"""Read a line from serial (or mock data)"""
-		try:
-			if self.use_mock:
-				return self._generate_mock_data()
-			
-			if self.ser and self.ser.in_waiting:
-				line = self.ser.readline().decode('utf-8').strip()
-				return line if line else None
-			
-			return None
-		except Exception as e:
-			print(f"[SERIAL] Read error: {e}")
-			return None
+		"""Read a line from serial (or mock data), without the controller tag"""
+		return self.read_tagged()[1]
+	
+	def write_all(self, data):
+		"""Send a command to every attached Arduino"""
+		with self.lock:
+			for device, ser in list(self.ports.items()):
+				try:
+					ser.write(data)
+				except Exception as e:
+					print(f"[SERIAL] Write error on {device}: {e}")
+					self._detach(device)
+	
+	def write_to(self, controller, data):
+		"""Send a command to one Arduino by controller (tty) name"""
+		with self.lock:
+			for device, ser in list(self.ports.items()):
+				if os.path.basename(device) != controller:
+					continue
+				try:
+					ser.write(data)
+				except Exception as e:
+					print(f"[SERIAL] Write error on {device}: {e}")
+					self._detach(device)
+	
+	def get_controllers(self):
+		"""Names of the attached controllers"""
+		with self.lock:
+			return [os.path.basename(d) for d in sorted(self.ports)]
 	
 	def _generate_mock_data(self):
 		"""Generate mock sensor data for testing"""
@@ -253,128 +503,2679 @@ class SerialHandler:
 			temp = 20 + random.uniform(-5, 15) + (self.mock_counter % 100) * 0.01
 			sensors.append(f"{sensor_id}:{temp:.2f}")
 		
-		data = ",".join(sensors)
-		time.sleep(0.5)
-		return data
+		data = ",".join(sensors)
+		time.sleep(0.5)
+		return data
+	
+	def disconnect(self):
+		"""Close all serial connections"""
+		with self.lock:
+			for device in list(self.ports):
+				self._detach(device)
+		self.is_connected = False
+		print("[SERIAL] Disconnected")
+
+# ============================================================================
+# LATEST-VALUE TABLE (SHARED MEMORY, SEQLOCK PER PROBE)
+# ============================================================================
+
+class LatestValueTable:
+	"""
+	Fixed-size table of the latest reading per probe, kept in a memory-mapped
+	file under /dev/shm so any process (Flask workers, CLI tools, controllers)
+	can snapshot it without taking a lock that the ingest path also needs.
+	
+	Each slot is guarded by its own sequence counter (seqlock): the writer
+	makes it odd, updates the slot, then makes it even again. Readers retry a
+	slot whose counter was odd or changed while they copied it. Only the
+	ingest process writes; writer_lock just serializes writers inside it.
+	
+	The header counts probes that found no free slot. While it is non-zero,
+	or if a slot stays busy, snapshot() returns None and the caller must ask
+	the ingest process (SensorDataManager) instead of showing a partial list.
+	
+	Reader usage from another process:
+		table = LatestValueTable.open()
+		sensors = table.snapshot()
+	"""
+	MAGIC = b"TMLV"
+	VERSION = 2
+	HEADER = struct.Struct("<4sHHI")  # magic, version, slot count, probes without a slot
+	SEQ = struct.Struct("<I")
+	SLOT = struct.Struct("<I24s32s16sddB3x")  # seq, id, name, controller, temperature, lastUpdate, online
+	
+	def __init__(self, mm, slots, writable):
+		self.mm = mm
+		self.slots = slots
+		self.writable = writable
+		self.writer_lock = threading.Lock()
+		self.index = {}  # sensor_id -> slot (writer side only)
+		self.overflow = set()  # Probes that found the table full (writer side only)
+	
+	@classmethod
+	def create(cls, path=LATEST_TABLE_PATH, slots=LATEST_TABLE_SLOTS):
+		"""Create (or reset) the table; called once by the ingest process"""
+		size = cls.HEADER.size + slots * cls.SLOT.size
+		fd = os.open(path, os.O_RDWR | os.O_CREAT | os.O_TRUNC, 0o644)
+		try:
+			os.ftruncate(fd, size)
+			mm = mmap.mmap(fd, size)
+		finally:
+			os.close(fd)
+		cls.HEADER.pack_into(mm, 0, cls.MAGIC, cls.VERSION, slots, 0)
+		return cls(mm, slots, writable=True)
+	
+	@classmethod
+	def open(cls, path=LATEST_TABLE_PATH):
+		"""Attach read-only to a table created by the ingest process"""
+		fd = os.open(path, os.O_RDONLY)
+		try:
+			mm = mmap.mmap(fd, 0, prot=mmap.PROT_READ)
+		finally:
+			os.close(fd)
+		magic, version, slots, _ = cls.HEADER.unpack_from(mm, 0)
+		if magic != cls.MAGIC or version != cls.VERSION:
+			raise ValueError(f"{path} is not a version {cls.VERSION} latest-value table")
+		return cls(mm, slots, writable=False)
+	
+	def _offset(self, slot):
+		return self.HEADER.size + slot * self.SLOT.size
+	
+	def _write_slot(self, slot, sensor_id, name, controller, temperature, last_update, online):
+		offset = self._offset(slot)
+		seq = self.SEQ.unpack_from(self.mm, offset)[0]
+		self.SEQ.pack_into(self.mm, offset, seq + 1)  # Odd: update in progress
+		self.SLOT.pack_into(self.mm, offset, seq + 1,
+			sensor_id.encode()[:24], name.encode('utf-8')[:32], (controller or "").encode()[:16],
+			temperature if temperature is not None else float('nan'), last_update, online)
+		self.SEQ.pack_into(self.mm, offset, seq + 2)
+	
+	def _set_overflow(self, sensor_id, full):
+		"""Track probes without a slot and mirror their count in the header (caller holds writer_lock)"""
+		before = len(self.overflow)
+		if full:
+			self.overflow.add(sensor_id)
+		else:
+			self.overflow.discard(sensor_id)
+		if len(self.overflow) != before:
+			self.HEADER.pack_into(self.mm, 0, self.MAGIC, self.VERSION, self.slots, len(self.overflow))
+			if full and not before:
+				print(f"[TABLE] All {self.slots} latest-value slots in use; /api/sensors reads under lock until probes are removed")
+	
+	def publish(self, sensor_id, sensor):
+		"""Store the latest state of one probe (sensor dict as kept by SensorDataManager)"""
+		with self.writer_lock:
+			slot = self.index.get(sensor_id)
+			if slot is None:
+				used = set(self.index.values())
+				slot = next((i for i in range(self.slots) if i not in used), None)
+				self._set_overflow(sensor_id, slot is None)
+				if slot is None:
+					return False  # Table full; snapshot() now defers to SensorDataManager
+				self.index[sensor_id] = slot
+			self._write_slot(slot, sensor_id, sensor["name"], sensor.get("controller"),
+				sensor["temperature"], sensor["lastUpdate"], sensor["status"] == "online")
+			return True
+	
+	def remove(self, sensor_id):
+		"""Free a probe's slot"""
+		with self.writer_lock:
+			self._set_overflow(sensor_id, False)
+			slot = self.index.pop(sensor_id, None)
+			if slot is not None:
+				self._write_slot(slot, "", "", None, None, 0.0, False)
+	
+	def clear(self):
+		"""Free every slot"""
+		for sensor_id in list(self.index) + list(self.overflow):
+			self.remove(sensor_id)
+	
+	def snapshot(self, max_retries=100):
+		"""
+		Copy every occupied slot without blocking the writer. Returns None if
+		the table does not hold every probe or a slot stayed busy through
+		max_retries reads; the caller then falls back to the locked data.
+		"""
+		if self.HEADER.unpack_from(self.mm, 0)[3]:
+			return None
+		sensors = {}
+		for slot in range(self.slots):
+			offset = self._offset(slot)
+			for _ in range(max_retries):
+				before = self.SEQ.unpack_from(self.mm, offset)[0]
+				if not before & 1:
+					fields = self.SLOT.unpack_from(self.mm, offset)
+					if self.SEQ.unpack_from(self.mm, offset)[0] == before:
+						break
+				time.sleep(0)  # Let an in-process writer finish the slot
+			else:
+				return None  # Writer kept the slot busy; never report a probe as missing
+			
+			_, sensor_id, name, controller, temperature, last_update, online = fields
+			sensor_id = sensor_id.rstrip(b"\0").decode()
+			if not sensor_id:
+				continue
+			sensors[sensor_id] = {
+				"temperature": None if temperature != temperature else temperature,
+				"status": "online" if online else "offline",
+				"lastUpdate": last_update,
+				"name": name.rstrip(b"\0").decode('utf-8', 'replace'),
+				"controller": controller.rstrip(b"\0").decode() or None
+			}
+		return sensors
+
+# ============================================================================
+# SENSOR DATA MANAGER
+# ============================================================================
+
+class SensorDataManager:
+	"""
+	Manages sensor data storage, validation, and retrieval.
+	Stores current readings and historical data.
+	"""
+	def __init__(self):
+		self.sensors = {}
+		self.history = {}
+		self.lock = threading.Lock()
+		self.mock_sensor_counter = 0
+		self.latest_table = None  # Optional LatestValueTable mirrored on every change
+		self.stats = ProbeStatistics()  # Rolling statistics fed by every reading
+		self.alerts = AlertEngine()  # Alert rules evaluated on every reading
+		self.deadlines = StaleProbes()  # Offline deadline per probe
+	
+	def _publish(self, sensor_id):
+		"""Mirror one sensor into the shared-memory table (caller holds self.lock)"""
+		if self.latest_table:
+			self.latest_table.publish(sensor_id, self.sensors[sensor_id])
+	
+	def update_sensor(self, sensor_id, temperature, status="online", controller=None, timestamp=None):
+		"""Update sensor reading (controller = tty name of the reporting Arduino)"""
+		timestamp = timestamp or time.time()
+		with self.lock:
+			if sensor_id not in self.sensors:
+				# Generate better name for mock sensors
+				if sensor_id.startswith('280000'):
+					self.mock_sensor_counter += 1
+					name = f"Mock Probe {self.mock_sensor_counter}"
+				else:
+					name = f"Probe {sensor_id[:8]}"
+				
+				self.sensors[sensor_id] = {
+					"temperature": temperature,
+					"status": status,
+					"lastUpdate": timestamp,
+					"name": name,
+					"controller": controller
+				}
+			else:
+				self.sensors[sensor_id]["temperature"] = temperature
+				self.sensors[sensor_id]["status"] = status
+				self.sensors[sensor_id]["lastUpdate"] = timestamp
+				self.sensors[sensor_id]["controller"] = controller
+			self._publish(sensor_id)
+		self.stats.add(sensor_id, timestamp, temperature)
+		self.alerts.ingest(sensor_id, timestamp, temperature)
+		self.deadlines.touch(sensor_id)
+	
+	def set_offline(self, sensor_id):
+		"""Mark sensor as offline"""
+		self.deadlines.remove(sensor_id)
+		with self.lock:
+			if sensor_id in self.sensors:
+				self.sensors[sensor_id]["status"] = "offline"
+				self._publish(sensor_id)
+	
+	def add_to_history(self, sensor_id, temperature, timestamp=None):
+		"""Add reading to history"""
+		with self.lock:
+			if sensor_id not in self.history:
+				self.history[sensor_id] = []
+			self.history[sensor_id].append({
+				"temperature": temperature,
+				"timestamp": timestamp or time.time()
+			})
+	
+	def get_sensors(self):
+		"""Get all sensor data"""
+		with self.lock:
+			return dict(self.sensors)
+	
+	def get_history(self):
+		"""Get historical data"""
+		with self.lock:
+			return dict(self.history)
+	
+	def rename_sensor(self, sensor_id, name):
+		"""Rename a sensor"""
+		with self.lock:
+			if sensor_id in self.sensors:
+				self.sensors[sensor_id]["name"] = name
+				self._publish(sensor_id)
+				print(f"[SENSOR] Renamed {sensor_id} to '{name}'")
+				return True
+			return False
+	
+	def delete_sensor(self, sensor_id):
+		"""Delete a sensor from tracking"""
+		with self.lock:
+			if sensor_id in self.sensors:
+				name = self.sensors[sensor_id]["name"]
+				del self.sensors[sensor_id]
+				if self.latest_table:
+					self.latest_table.remove(sensor_id)
+				self.stats.remove(sensor_id)
+				self.deadlines.remove(sensor_id)
+				# Also remove from history if exists
+				if sensor_id in self.history:
+					del self.history[sensor_id]
+				print(f"[SENSOR] Deleted {sensor_id} ({name})")
+				return True
+			return False
+	
+	def expire_stale(self):
+		"""Mark offline the probes whose deadline has passed; returns their IDs"""
+		expired = self.deadlines.expire()
+		with self.lock:
+			for sensor_id in expired:
+				if sensor_id in self.sensors and self.sensors[sensor_id]["status"] != "offline":
+					self.sensors[sensor_id]["status"] = "offline"
+					self._publish(sensor_id)
+		return expired
+	
+	def clear(self):
+		"""Forget all sensors"""
+		with self.lock:
+			self.sensors.clear()
+			if self.latest_table:
+				self.latest_table.clear()
+			self.stats.clear()
+			self.deadlines.clear()
+
+# ============================================================================
+# NATIVE ENGINE (OPTIONAL C ABI LIBRARY, PURE-PYTHON FALLBACK)
+# ============================================================================
+
+class TmReading(ctypes.Structure):
+	"""Mirror of tm_reading in native/tempmon_native.h"""
+	_fields_ = [("id", ctypes.c_char * 24), ("temperature", ctypes.c_double)]
+
+class TmArchiveReport(ctypes.Structure):
+	"""Mirror of tm_archive_report in native/tempmon_native.h"""
+	_fields_ = [(name, ctypes.c_long) for name in ("rows", "skipped", "chunks", "columns",
+		"source_bytes", "archive_bytes", "timestamp_bits", "value_bits")]
+
+class TmWindowStats(ctypes.Structure):
+	"""Mirror of tm_window_stats in native/tempmon_native.h"""
+	_fields_ = [("seconds", ctypes.c_double), ("count", ctypes.c_long), ("span", ctypes.c_double),
+		("mean", ctypes.c_double), ("stddev", ctypes.c_double), ("slope", ctypes.c_double),
+		("min", ctypes.c_double), ("max", ctypes.c_double)]
+
+class TmProbeStats(ctypes.Structure):
+	"""Mirror of tm_probe_stats in native/tempmon_native.h"""
+	_fields_ = [("count", ctypes.c_long), ("last", ctypes.c_double), ("last_time", ctypes.c_double),
+		("ewma", ctypes.c_double), ("windows", ctypes.c_int), ("window", TmWindowStats * 4)]
+
+class TmAlertRule(ctypes.Structure):
+	"""Mirror of tm_alert_rule in native/tempmon_native.h"""
+	_fields_ = [("kind", ctypes.c_int), ("probe", ctypes.c_int), ("other", ctypes.c_int),
+		("limit", ctypes.c_double), ("hysteresis", ctypes.c_double)]
+
+class TmAlertEvent(ctypes.Structure):
+	"""Mirror of tm_alert_event in native/tempmon_native.h"""
+	_fields_ = [("rule", ctypes.c_int), ("raised", ctypes.c_int), ("time", ctypes.c_double), ("value", ctypes.c_double)]
+
+class NativeEngine:
+	"""
+	ctypes binding to native/libtempmon.so (parser, session reader and archive,
+	downsampler, rolling statistics, alert rules, timer wheel, PID loop). Every method returns
+	exactly what the pure-Python version below returns, so callers never need
+	to know which one ran.
+	"""
+	ABI_VERSION = 6
+	MAX_READINGS = 64
+	STATS_MAX_WINDOWS = 4
+	
+	def __init__(self, path):
+		lib = ctypes.CDLL(path)
+		lib.tm_abi_version.restype = ctypes.c_int
+		if lib.tm_abi_version() != self.ABI_VERSION:
+			raise OSError(f"ABI version {lib.tm_abi_version()}, expected {self.ABI_VERSION}")
+		
+		lib.tm_parse_line.argtypes = [ctypes.c_char_p, ctypes.POINTER(TmReading), ctypes.c_int]
+		lib.tm_parse_line.restype = ctypes.c_int
+		lib.tm_session_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p]
+		lib.tm_session_open.restype = ctypes.c_void_p
+		lib.tm_session_close.argtypes = [ctypes.c_void_p]
+		lib.tm_session_columns.argtypes = [ctypes.c_void_p]
+		lib.tm_session_columns.restype = ctypes.c_int
+		lib.tm_session_column.argtypes = [ctypes.c_void_p, ctypes.c_int]
+		lib.tm_session_column.restype = ctypes.c_char_p
+		lib.tm_session_rows.argtypes = [ctypes.c_void_p]
+		lib.tm_session_rows.restype = ctypes.c_long
+		lib.tm_session_timestamp.argtypes = [ctypes.c_void_p, ctypes.c_long]
+		lib.tm_session_timestamp.restype = ctypes.c_char_p
+		lib.tm_session_timestamps.argtypes = [ctypes.c_void_p]
+		lib.tm_session_timestamps.restype = ctypes.c_char_p
+		lib.tm_session_values.argtypes = [ctypes.c_void_p]
+		lib.tm_session_values.restype = ctypes.POINTER(ctypes.c_double)
+		lib.tm_archive_write.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_long, ctypes.POINTER(TmArchiveReport)]
+		lib.tm_archive_write.restype = ctypes.c_int
+		lib.tm_downsample_lttb.argtypes = [ctypes.POINTER(ctypes.c_double), ctypes.c_long, ctypes.c_long, ctypes.POINTER(ctypes.c_long)]
+		lib.tm_downsample_lttb.restype = ctypes.c_long
+		lib.tm_stats_create.argtypes = [ctypes.c_int, ctypes.c_long, ctypes.POINTER(ctypes.c_double), ctypes.c_int, ctypes.c_double]
+		lib.tm_stats_create.restype = ctypes.c_void_p
+		lib.tm_stats_destroy.argtypes = [ctypes.c_void_p]
+		lib.tm_stats_add.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_double, ctypes.c_double]
+		lib.tm_stats_reset.argtypes = [ctypes.c_void_p, ctypes.c_int]
+		lib.tm_stats_get.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(TmProbeStats)]
+		lib.tm_stats_get.restype = ctypes.c_int
+		lib.tm_alerts_create.argtypes = [ctypes.POINTER(TmAlertRule), ctypes.c_int, ctypes.c_int, ctypes.c_double, ctypes.c_int]
+		lib.tm_alerts_create.restype = ctypes.c_void_p
+		lib.tm_alerts_destroy.argtypes = [ctypes.c_void_p]
+		lib.tm_alerts_ingest.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_double, ctypes.c_double]
+		lib.tm_alerts_ingest.restype = ctypes.c_int
+		lib.tm_alerts_tick.argtypes = [ctypes.c_void_p, ctypes.c_double]
+		lib.tm_alerts_tick.restype = ctypes.c_int
+		lib.tm_alerts_poll.argtypes = [ctypes.c_void_p, ctypes.POINTER(TmAlertEvent), ctypes.c_int]
+		lib.tm_alerts_poll.restype = ctypes.c_int
+		lib.tm_alerts_dropped.argtypes = [ctypes.c_void_p]
+		lib.tm_alerts_dropped.restype = ctypes.c_long
+		lib.tm_wheel_create.argtypes = [ctypes.c_int, ctypes.c_double, ctypes.c_double]
+		lib.tm_wheel_create.restype = ctypes.c_void_p
+		lib.tm_wheel_destroy.argtypes = [ctypes.c_void_p]
+		lib.tm_wheel_schedule.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_double]
+		lib.tm_wheel_cancel.argtypes = [ctypes.c_void_p, ctypes.c_int]
+		lib.tm_wheel_advance.argtypes = [ctypes.c_void_p, ctypes.c_double, ctypes.POINTER(ctypes.c_int), ctypes.c_int]
+		lib.tm_wheel_advance.restype = ctypes.c_int
+		lib.tm_pid_start.argtypes = [ctypes.POINTER(TmPidConfig), ctypes.c_char_p]
+		lib.tm_pid_start.restype = ctypes.c_void_p
+		lib.tm_pid_stop.argtypes = [ctypes.c_void_p]
+		lib.tm_pid_configure.argtypes = [ctypes.c_void_p, ctypes.POINTER(TmPidConfig)]
+		lib.tm_pid_configure.restype = ctypes.c_int
+		lib.tm_pid_feed.argtypes = [ctypes.c_void_p, ctypes.c_double]
+		lib.tm_pid_get.argtypes = [ctypes.c_void_p, ctypes.POINTER(TmPidStatus)]
+		lib.tm_pid_get.restype = ctypes.c_int
+		
+		self.lib = lib
+		self.readings = (TmReading * self.MAX_READINGS)()
+	
+	def parse_line(self, line):
+		"""[(sensor_id, temperature)] for a clean data line, else None"""
+		count = self.lib.tm_parse_line(line.encode('utf-8', 'replace'), self.readings, self.MAX_READINGS)
+		if count < 0:
+			return None
+		return [(r.id.decode(), r.temperature) for r in self.readings[:count]]
+	
+	def load_session(self, csv_path, start=None, end=None):
+		"""Same rows as load_session_rows(), parsed natively"""
+		session = self.lib.tm_session_open(str(csv_path).encode(),
+			start.encode() if start else None, end.encode() if end else None)
+		if not session:
+			raise OSError(f"Could not read {csv_path}")
+		try:
+			headers = [self.lib.tm_session_column(session, i).decode('utf-8', 'replace')
+				for i in range(self.lib.tm_session_columns(session))]
+			rows = self.lib.tm_session_rows(session)
+			if not rows:
+				return []
+			width = len(headers)
+			timestamps = self.lib.tm_session_timestamps(session).decode('utf-8', 'replace').split('\n')
+			values = self.lib.tm_session_values(session)[:rows * width] if width else []
+			values = [None if v != v else v for v in values]  # NaN marks NC/missing
+			
+			return [{"timestamp": timestamps[row], "readings": dict(zip(headers, values[row * width:(row + 1) * width]))}
+				for row in range(rows)]
+		finally:
+			self.lib.tm_session_close(session)
+	
+	def count_rows(self, path):
+		"""Rows a session file decodes to"""
+		session = self.lib.tm_session_open(str(path).encode(), None, None)
+		if not session:
+			raise OSError(f"Could not read {path}")
+		try:
+			return self.lib.tm_session_rows(session)
+		finally:
+			self.lib.tm_session_close(session)
+	
+	def write_archive(self, csv_path, out_path, chunk_rows):
+		"""Same report as write_archive(), compacted natively"""
+		report = TmArchiveReport()
+		if self.lib.tm_archive_write(str(csv_path).encode(), str(out_path).encode(), chunk_rows, ctypes.byref(report)) != 0:
+			raise OSError(f"Could not archive {csv_path} to {out_path}")
+		return {name: getattr(report, name) for name, _ in TmArchiveReport._fields_}
+	
+	def downsample(self, values, threshold):
+		"""Indices chosen by LTTB (None values score as 0)"""
+		n = len(values)
+		ys = (ctypes.c_double * n)(*[float('nan') if v is None else v for v in values])
+		out = (ctypes.c_long * max(threshold, 0))()
+		count = self.lib.tm_downsample_lttb(ys, n, threshold, out)
+		return list(out[:count])
+	
+	def stats_create(self, probes, capacity, windows, ewma_tau):
+		"""Handle to native rolling statistics for probe slots 0..probes-1"""
+		if len(windows) > self.STATS_MAX_WINDOWS:
+			raise ValueError(f"At most {self.STATS_MAX_WINDOWS} statistics windows")
+		seconds = (ctypes.c_double * len(windows))(*windows)
+		handle = self.lib.tm_stats_create(probes, capacity, seconds, len(windows), ewma_tau)
+		if not handle:
+			raise ValueError("Bad statistics configuration")
+		return handle
+	
+	def stats_destroy(self, handle):
+		self.lib.tm_stats_destroy(handle)
+	
+	def stats_add(self, handle, probe, timestamp, value):
+		self.lib.tm_stats_add(handle, probe, timestamp, value)
+	
+	def stats_reset(self, handle, probe):
+		self.lib.tm_stats_reset(handle, probe)
+	
+	def stats_get(self, handle, probe):
+		"""Same dict as RollingStats.summary()"""
+		out = TmProbeStats()
+		if self.lib.tm_stats_get(handle, probe, ctypes.byref(out)) != 0:
+			return None
+		return {"count": out.count, "last": out.last, "last_time": out.last_time, "ewma": out.ewma,
+			"windows": [{name: getattr(w, name) for name, _ in TmWindowStats._fields_}
+				for w in out.window[:out.windows]]}
+	
+	def alerts_create(self, rules, probes, slope_tau, queue_size):
+		"""Handle to a native compiled rule set; rules are RuleTable tuples"""
+		table = (TmAlertRule * max(len(rules), 1))(*[TmAlertRule(*rule) for rule in rules])
+		handle = self.lib.tm_alerts_create(table, len(rules), probes, slope_tau, queue_size)
+		if not handle:
+			raise ValueError("Malformed alert rule")
+		return NativeRuleTable(self.lib, handle, queue_size)
+	
+	def wheel_create(self, timers, tick, start):
+		"""Native TimerWheel for timers 0..timers-1"""
+		handle = self.lib.tm_wheel_create(timers, tick, start)
+		if not handle:
+			raise ValueError("Bad timer wheel configuration")
+		return NativeTimerWheel(self.lib, handle, timers)
+	
+	def pid_start(self, config, heater_path):
+		"""Native PidLoop running on its own thread"""
+		handle = self.lib.tm_pid_start(ctypes.byref(pid_config_struct(config)), heater_path.encode() if heater_path else None)
+		if not handle:
+			raise ValueError("Bad PID settings")
+		return NativePidLoop(self.lib, handle)
+
+class NativeTimerWheel:
+	"""A native timer wheel with the TimerWheel interface"""
+	def __init__(self, lib, handle, timers):
+		self.lib = lib
+		self.handle = handle
+		self.fired = (ctypes.c_int * timers)()
+	
+	def __del__(self):
+		self.lib.tm_wheel_destroy(self.handle)
+	
+	def schedule(self, timer, deadline):
+		self.lib.tm_wheel_schedule(self.handle, timer, deadline)
+	
+	def cancel(self, timer):
+		self.lib.tm_wheel_cancel(self.handle, timer)
+	
+	def advance(self, now):
+		fired = []
+		while True:
+			count = self.lib.tm_wheel_advance(self.handle, now, self.fired, len(self.fired))
+			fired.extend(self.fired[:count])
+			if count < len(self.fired):
+				return fired
+
+class TmPidConfig(ctypes.Structure):
+	"""Mirror of tm_pid_config in native/tempmon_native.h"""
+	_fields_ = [(name, ctypes.c_double) for name in ("setpoint", "kp", "ki", "kd", "derivative_tau",
+		"out_min", "out_max", "period", "window", "feedback_timeout")]
+
+class TmPidStatus(ctypes.Structure):
+	"""Mirror of tm_pid_status in native/tempmon_native.h"""
+	_fields_ = [("feedback_ok", ctypes.c_int), ("heater_on", ctypes.c_int), ("feedback", ctypes.c_double),
+		("feedback_age", ctypes.c_double), ("output", ctypes.c_double), ("p", ctypes.c_double),
+		("i", ctypes.c_double), ("d", ctypes.c_double), ("ticks", ctypes.c_long), ("overruns", ctypes.c_long),
+		("jitter_last_us", ctypes.c_double), ("jitter_mean_us", ctypes.c_double),
+		("jitter_max_us", ctypes.c_double), ("jitter_stddev_us", ctypes.c_double)]
+
+class NativePidLoop:
+	"""A native PID loop thread with the PidLoop interface"""
+	def __init__(self, lib, handle):
+		self.lib = lib
+		self.handle = handle
+	
+	def configure(self, config):
+		if self.lib.tm_pid_configure(self.handle, ctypes.byref(pid_config_struct(config))) != 0:
+			raise ValueError("Bad PID settings")
+	
+	def feed(self, value):
+		self.lib.tm_pid_feed(self.handle, value)
+	
+	def status(self):
+		out = TmPidStatus()
+		self.lib.tm_pid_get(self.handle, ctypes.byref(out))
+		return {name: getattr(out, name) for name, _ in TmPidStatus._fields_}
+	
+	def stop(self):
+		if self.handle:
+			self.lib.tm_pid_stop(self.handle)
+			self.handle = None
+
+def pid_config_struct(config):
+	return TmPidConfig(*[float(config[name]) for name, _ in TmPidConfig._fields_])
+
+class NativeRuleTable:
+	"""A compiled native rule set with the RuleTable interface"""
+	def __init__(self, lib, handle, queue_size):
+		self.lib = lib
+		self.handle = handle
+		self.events = (TmAlertEvent * queue_size)()
+	
+	def __del__(self):
+		self.lib.tm_alerts_destroy(self.handle)
+	
+	def ingest(self, probe, timestamp, value):
+		return self.lib.tm_alerts_ingest(self.handle, probe, timestamp, value)
+	
+	def tick(self, now):
+		return self.lib.tm_alerts_tick(self.handle, now)
+	
+	def poll(self):
+		count = self.lib.tm_alerts_poll(self.handle, self.events, len(self.events))
+		return [(e.rule, bool(e.raised), e.time, e.value) for e in self.events[:count]]
+	
+	def dropped(self):
+		return self.lib.tm_alerts_dropped(self.handle)
+
+def load_native_engine(path=NATIVE_LIB_PATH):
+	"""Load the native engine, or return None to use the pure-Python paths"""
+	if not Path(path).exists():
+		return None
+	try:
+		engine = NativeEngine(path)
+		print(f"[NATIVE] Loaded {path}")
+		return engine
+	except (OSError, AttributeError) as e:
+		print(f"[NATIVE] Ignoring {path}: {e}")
+		return None
+
+native_engine = load_native_engine()
+
+def parse_data_line(line):
+	"""
+	Fast path for a plain data line "id:temp,id:temp,...".
+	Returns [(sensor_id, temperature)], or None if any part of the line needs
+	the reader's message-by-message handling (info/error text, bad IDs/values).
+	"""
+	if native_engine:
+		return native_engine.parse_line(line)
+	
+	readings = []
+	for reading in line.split(','):
+		reading = reading.strip()
+		if not reading:
+			continue
+		parts = reading.split(':')
+		if len(parts) != 2:
+			return None
+		sensor_id = parts[0].strip()
+		if not 16 <= len(sensor_id) < 24 or any(c not in "0123456789abcdefABCDEF" for c in sensor_id):
+			return None
+		try:
+			readings.append((sensor_id, float(parts[1])))
+		except ValueError:
+			return None
+	return readings
+
+# ============================================================================
+# ROLLING PROBE STATISTICS
+# ============================================================================
+
+class RollingStats:
+	"""
+	Pure-Python twin of the native rolling statistics for one probe: a
+	time-weighted EWMA plus, per sliding window, Welford mean/variance, the
+	least-squares slope (from the time/value co-moment) and min/max (from
+	monotonic queues). Samples are added to and retired from each window once,
+	so add() is amortized O(1) and summary() is O(1).
+	"""
+	def __init__(self, windows, capacity, ewma_tau):
+		self.capacity = capacity
+		self.ewma_tau = ewma_tau
+		self.windows = [{"seconds": seconds, "samples": deque(), "mean_t": 0.0, "mean_v": 0.0,
+			"m2_t": 0.0, "m2_v": 0.0, "co_tv": 0.0, "min": deque(), "max": deque()} for seconds in windows]
+		self.count = 0
+		self.next = 0
+		self.epoch = 0.0
+		self.last = 0.0
+		self.last_time = 0.0
+		self.ewma = 0.0
+	
+	def add(self, timestamp, value):
+		if self.count == 0:
+			self.epoch = timestamp
+			self.ewma = value
+		else:
+			timestamp = max(timestamp, self.last_time)
+			weight = 1 - math.exp(-(timestamp - self.last_time) / self.ewma_tau) if self.ewma_tau > 0 else 1
+			self.ewma += weight * (value - self.ewma)
+		self.count += 1
+		self.last = value
+		self.last_time = timestamp
+		
+		seq = self.next
+		self.next += 1
+		t = timestamp - self.epoch
+		for w in self.windows:
+			# Only the last `capacity` samples are kept
+			if w["samples"] and w["samples"][0][0] <= seq - self.capacity:
+				self._remove_oldest(w)
+			self._add(w, seq, t, value)
+			while len(w["samples"]) > 1 and w["samples"][0][1] < t - w["seconds"]:
+				self._remove_oldest(w)
+	
+	@staticmethod
+	def _add(w, seq, t, v):
+		w["samples"].append((seq, t, v))
+		n = len(w["samples"])
+		d_t = t - w["mean_t"]
+		d_v = v - w["mean_v"]
+		w["mean_t"] += d_t / n
+		w["mean_v"] += d_v / n
+		w["m2_t"] += d_t * (t - w["mean_t"])
+		w["m2_v"] += d_v * (v - w["mean_v"])
+		w["co_tv"] += d_t * (v - w["mean_v"])
+		
+		while w["min"] and w["min"][-1][1] >= v:
+			w["min"].pop()
+		w["min"].append((seq, v))
+		while w["max"] and w["max"][-1][1] <= v:
+			w["max"].pop()
+		w["max"].append((seq, v))
+	
+	@staticmethod
+	def _remove_oldest(w):
+		seq, t, v = w["samples"].popleft()
+		if w["min"] and w["min"][0][0] == seq:
+			w["min"].popleft()
+		if w["max"] and w["max"][0][0] == seq:
+			w["max"].popleft()
+		
+		n = len(w["samples"])
+		if n == 0:
+			w.update(mean_t=0.0, mean_v=0.0, m2_t=0.0, m2_v=0.0, co_tv=0.0)
+			return
+		old_mean_v = w["mean_v"]
+		d_t = t - w["mean_t"]
+		w["mean_t"] -= d_t / n
+		w["mean_v"] -= (v - w["mean_v"]) / n
+		w["m2_t"] = max(w["m2_t"] - (t - w["mean_t"]) * d_t, 0.0)
+		w["m2_v"] = max(w["m2_v"] - (v - w["mean_v"]) * (v - old_mean_v), 0.0)
+		w["co_tv"] -= (t - w["mean_t"]) * (v - old_mean_v)
+	
+	def summary(self):
+		"""Current statistics (slope in °C/s, as from tm_stats_get)"""
+		windows = []
+		for w in self.windows:
+			n = len(w["samples"])
+			if n == 0:
+				windows.append({"seconds": w["seconds"], "count": 0, "span": 0.0, "mean": 0.0,
+					"stddev": 0.0, "slope": 0.0, "min": 0.0, "max": 0.0})
+				continue
+			windows.append({
+				"seconds": w["seconds"],
+				"count": n,
+				"span": self.last_time - self.epoch - w["samples"][0][1],
+				"mean": w["mean_v"],
+				"stddev": math.sqrt(w["m2_v"] / (n - 1)) if n > 1 else 0.0,
+				"slope": w["co_tv"] / w["m2_t"] if n > 1 and w["m2_t"] > 0 else 0.0,
+				"min": w["min"][0][1],
+				"max": w["max"][0][1]
+			})
+		return {"count": self.count, "last": self.last, "last_time": self.last_time, "ewma": self.ewma, "windows": windows}
+
+class ProbeStatistics:
+	"""
+	Rolling statistics for every probe, updated on each reading in fixed
+	memory (at most STATS_CAPACITY samples per probe) and read in O(1). Uses the
+	native engine when it is loaded, RollingStats otherwise.
+	"""
+	def __init__(self, windows=STATS_WINDOWS, capacity=STATS_CAPACITY, ewma_tau=STATS_EWMA_TAU, max_probes=STATS_MAX_PROBES):
+		self.windows = tuple(windows)
+		self.capacity = capacity
+		self.ewma_tau = ewma_tau
+		self.max_probes = max_probes
+		self.lock = threading.Lock()
+		self.slots = {}  # sensor_id -> slot
+		self.free = list(range(max_probes - 1, -1, -1))
+		self.untracked = set()  # Probes whose readings were dropped for want of a slot
+		self.handle = None
+		self.rolling = [None] * max_probes  # Pure-Python stats per slot
+		if native_engine:
+			self.handle = native_engine.stats_create(max_probes, capacity, self.windows, ewma_tau)
+	
+	def add(self, sensor_id, timestamp, temperature):
+		"""Feed one reading (dropped, and the probe listed in untracked, once max_probes probes are tracked)"""
+		if temperature is None:
+			return
+		with self.lock:
+			slot = self.slots.get(sensor_id)
+			if slot is None:
+				if not self.free:
+					if sensor_id not in self.untracked:
+						self.untracked.add(sensor_id)
+						print(f"[STATS] All {self.max_probes} statistics slots in use; no statistics for {sensor_id} until a probe is removed")
+					return
+				self.untracked.discard(sensor_id)
+				slot = self.slots[sensor_id] = self.free.pop()
+				if not self.handle:
+					self.rolling[slot] = RollingStats(self.windows, self.capacity, self.ewma_tau)
+			if self.handle:
+				native_engine.stats_add(self.handle, slot, timestamp, temperature)
+			else:
+				self.rolling[slot].add(timestamp, temperature)
+	
+	def remove(self, sensor_id):
+		with self.lock:
+			self._release(sensor_id)
+	
+	def clear(self):
+		with self.lock:
+			for sensor_id in list(self.slots):
+				self._release(sensor_id)
+			self.untracked.clear()
+	
+	def _release(self, sensor_id):
+		"""Forget one probe and free its slot (caller holds self.lock)"""
+		self.untracked.discard(sensor_id)
+		slot = self.slots.pop(sensor_id, None)
+		if slot is None:
+			return
+		if self.handle:
+			native_engine.stats_reset(self.handle, slot)
+		self.rolling[slot] = None
+		self.free.append(slot)
+	
+	def get(self, sensor_id):
+		"""Statistics of one probe, or None if it has no readings"""
+		with self.lock:
+			slot = self.slots.get(sensor_id)
+			if slot is None:
+				return None
+			raw = native_engine.stats_get(self.handle, slot) if self.handle else self.rolling[slot].summary()
+		return self._format(raw)
+	
+	def snapshot(self):
+		"""Statistics of every tracked probe"""
+		with self.lock:
+			ids = list(self.slots)
+		stats = {}
+		for sensor_id in ids:
+			summary = self.get(sensor_id)
+			if summary:
+				stats[sensor_id] = summary
+		return stats
+	
+	@staticmethod
+	def _format(raw):
+		"""API shape: rounded values, slopes in °C/min, windows keyed by seconds"""
+		return {
+			"count": raw["count"],
+			"last": round(raw["last"], 4),
+			"lastUpdate": raw["last_time"],
+			"ewma": round(raw["ewma"], 4),
+			"windows": {str(int(w["seconds"])): {
+				"count": w["count"],
+				"span": round(w["span"], 3),
+				"mean": round(w["mean"], 4),
+				"stddev": round(w["stddev"], 4),
+				"slope": round(w["slope"] * 60, 4),
+				"min": round(w["min"], 4),
+				"max": round(w["max"], 4)
+			} for w in raw["windows"]}
+		}
+
+# ============================================================================
+# STREAMING ALERT RULES
+# ============================================================================
+
+class RuleTable:
+	"""
+	Pure-Python twin of the native compiled rule set. Rules are tuples
+	(kind, probe, other, limit, hysteresis) over probe indices; each probe
+	gets the flat list of rules that name it, so a reading visits only those.
+	STALE rules are raised by tick() and cleared by the probe's next reading.
+	"""
+	ABOVE, BELOW, SLOPE, DEVIATION, STALE = range(5)
+	
+	def __init__(self, rules, probes, slope_tau, queue_size):
+		self.rules = list(rules)
+		self.active = [False] * len(self.rules)
+		self.by_probe = [[] for _ in range(probes)]
+		self.stale = []
+		for index, (kind, probe, other, limit, hysteresis) in enumerate(self.rules):
+			self.by_probe[probe].append(index)
+			if kind == self.DEVIATION:
+				self.by_probe[other].append(index)
+			elif kind == self.STALE:
+				self.stale.append(index)
+		# Per probe: [last time, value, level, slope]; None until seen
+		self.probes = [None] * probes
+		self.slope_tau = slope_tau
+		self.queue = deque()
+		self.queue_size = queue_size
+		self.lost = 0
+		self.first_tick = None
+	
+	def _push(self, rule, raised, timestamp, value):
+		self.active[rule] = raised
+		if len(self.queue) == self.queue_size:
+			self.queue.popleft()
+			self.lost += 1
+		self.queue.append((rule, raised, timestamp, value))
+	
+	def _evaluate(self, rule, measure, timestamp):
+		"""Raise when measure > limit, clear once it is back under limit - hysteresis"""
+		limit, hysteresis = self.rules[rule][3], self.rules[rule][4]
+		if not self.active[rule]:
+			if measure > limit:
+				self._push(rule, True, timestamp, measure)
+		elif measure < limit - hysteresis:
+			self._push(rule, False, timestamp, measure)
+	
+	def ingest(self, probe, timestamp, value):
+		state = self.probes[probe]
+		if state is None:
+			state = self.probes[probe] = [timestamp, value, value, 0.0]
+		elif timestamp > state[0]:
+			dt = timestamp - state[0]
+			weight = 1 - math.exp(-dt / self.slope_tau) if self.slope_tau > 0 else 1
+			level = state[2] + weight * (value - state[2])
+			state[3] += weight * ((level - state[2]) / dt - state[3])
+			state[2] = level
+			state[0] = timestamp
+		state[1] = value
+		
+		for rule in self.by_probe[probe]:
+			kind, _, other, limit, hysteresis = self.rules[rule]
+			if kind == self.ABOVE:
+				self._evaluate(rule, value, timestamp)
+			elif kind == self.BELOW:
+				if not self.active[rule]:
+					if value < limit:
+						self._push(rule, True, timestamp, value)
+				elif value > limit + hysteresis:
+					self._push(rule, False, timestamp, value)
+			elif kind == self.SLOPE:
+				self._evaluate(rule, abs(state[3]), timestamp)
+			elif kind == self.DEVIATION:
+				a, b = self.probes[self.rules[rule][1]], self.probes[other]
+				if a and b:
+					self._evaluate(rule, abs(a[1] - b[1]), timestamp)
+			elif kind == self.STALE and self.active[rule]:
+				self._push(rule, False, timestamp, 0.0)
+		return len(self.queue)
+	
+	def tick(self, now):
+		if self.first_tick is None:
+			self.first_tick = now
+		for rule in self.stale:
+			state = self.probes[self.rules[rule][1]]
+			age = now - (state[0] if state else self.first_tick)
+			if not self.active[rule] and age > self.rules[rule][3]:
+				self._push(rule, True, now, age)
+		return len(self.queue)
+	
+	def poll(self):
+		events = list(self.queue)
+		self.queue.clear()
+		return events
+	
+	def dropped(self):
+		return self.lost
+
+class AlertEngine:
+	"""
+	Alert rules evaluated on the ingest stream. Rules (JSON dicts) are
+	compiled into a RuleTable (native when libtempmon is loaded) over the
+	probes they name; readings of other probes cost one dict lookup. Events
+	queue up inside the table until the reader thread drains them.
+	  {"id": "oven-high", "type": "above", "sensor_id": "28...", "limit": 80}
+	Types: above/below (°C), slope (|dT/dt| in °C/min), deviation (needs
+	"other_id", °C apart), stale (seconds without a reading). "hysteresis"
+	(rule units, default ALERT_HYSTERESIS) keeps a raised alert from chattering.
+	"""
+	KINDS = {"above": RuleTable.ABOVE, "below": RuleTable.BELOW, "slope": RuleTable.SLOPE,
+		"deviation": RuleTable.DEVIATION, "stale": RuleTable.STALE}
+	
+	def __init__(self, slope_tau=ALERT_SLOPE_TAU, queue_size=ALERT_QUEUE_SIZE, history=ALERT_EVENT_HISTORY):
+		self.slope_tau = slope_tau
+		self.queue_size = queue_size
+		self.lock = threading.Lock()
+		self.rules = []
+		self.slots = {}  # sensor_id -> probe index in the table
+		self.table = None
+		self.pending = False
+		self.active = {}  # rule id -> event that raised it
+		self.events = deque(maxlen=history)
+		self.last_tick = 0
+	
+	def set_rules(self, rules):
+		"""Validate and compile a new rule set (ValueError if any rule is bad)"""
+		normalized = []
+		slots = {}
+		compiled = []
+		for n, rule in enumerate(rules):
+			if not isinstance(rule, dict) or rule.get("type") not in self.KINDS:
+				raise ValueError(f"Rule {n}: type must be one of {', '.join(self.KINDS)}")
+			kind = rule["type"]
+			sensor_id = str(rule.get("sensor_id") or '').strip().lower()
+			other_id = str(rule.get("other_id") or '').strip().lower()
+			try:
+				limit = float(rule["limit"])
+				hysteresis = float(rule.get("hysteresis", ALERT_HYSTERESIS))
+			except (KeyError, TypeError, ValueError):
+				raise ValueError(f"Rule {n}: numeric 'limit' required")
+			if not sensor_id:
+				raise ValueError(f"Rule {n}: 'sensor_id' required")
+			if kind == "deviation" and (not other_id or other_id == sensor_id):
+				raise ValueError(f"Rule {n}: deviation needs a different 'other_id'")
+			if (kind in ("slope", "deviation", "stale") and limit <= 0) or hysteresis < 0:
+				raise ValueError(f"Rule {n}: limit must be positive and hysteresis not negative")
+			
+			entry = {"id": str(rule.get("id") or f"{kind}-{n}"), "type": kind, "sensor_id": sensor_id,
+				"limit": limit, "hysteresis": hysteresis}
+			if kind == "deviation":
+				entry["other_id"] = other_id
+			if any(r["id"] == entry["id"] for r in normalized):
+				raise ValueError(f"Rule {n}: duplicate id {entry['id']}")
+			normalized.append(entry)
+			
+			probe = slots.setdefault(sensor_id, len(slots))
+			other = slots.setdefault(other_id, len(slots)) if other_id and kind == "deviation" else -1
+			scale = 1 / 60 if kind == "slope" else 1  # Tables compare °C/s
+			compiled.append((self.KINDS[kind], probe, other, limit * scale, hysteresis * scale))
+		
+		if native_engine:
+			table = native_engine.alerts_create(compiled, len(slots), self.slope_tau, self.queue_size)
+		else:
+			table = RuleTable(compiled, len(slots), self.slope_tau, self.queue_size)
+		with self.lock:
+			self.rules, self.slots, self.table = normalized, slots, table
+			self.active = {}
+			self.pending = False
+	
+	def ingest(self, sensor_id, timestamp, temperature):
+		"""Feed one reading; only probes named by a rule reach the table"""
+		if temperature is None:
+			return
+		with self.lock:
+			probe = self.slots.get(sensor_id)
+			if probe is not None:
+				self.pending = self.table.ingest(probe, timestamp, temperature) > 0 or self.pending
+	
+	def check(self, now=None):
+		"""Tick staleness rules when due and drain queued events (reader thread)"""
+		now = now or time.time()
+		with self.lock:
+			if not self.table:
+				return []
+			if now - self.last_tick >= ALERT_TICK_INTERVAL:
+				self.last_tick = now
+				self.pending = self.table.tick(now) > 0 or self.pending
+			if not self.pending:
+				return []
+			self.pending = False
+			events = []
+			for rule, raised, timestamp, value in self.table.poll():
+				spec = self.rules[rule]
+				event = {"rule": spec["id"], "type": spec["type"], "sensor_id": spec["sensor_id"],
+					"state": "raised" if raised else "cleared", "timestamp": timestamp,
+					"value": round(value * 60 if spec["type"] == "slope" else value, 4)}
+				if raised:
+					self.active[spec["id"]] = event
+				else:
+					self.active.pop(spec["id"], None)
+				self.events.append(event)
+				events.append(event)
+			return events
+	
+	def status(self):
+		with self.lock:
+			return {
+				"rules": list(self.rules),
+				"active": list(self.active.values()),
+				"events": list(self.events),
+				"dropped": self.table.dropped() if self.table else 0
+			}
+	
+	def load(self, path=ALERT_RULES_PATH):
+		"""Compile the rules saved at path, if any; returns how many"""
+		if not Path(path).exists():
+			return 0
+		with open(path) as f:
+			self.set_rules(json.load(f))
+		return len(self.rules)
+	
+	def save(self, path=ALERT_RULES_PATH):
+		with open(path, 'w') as f:
+			json.dump(self.rules, f, indent=2)
+
+# ============================================================================
+# STALE-PROBE DEADLINES (TIMER WHEEL)
+# ============================================================================
+
+class TimerWheel:
+	"""
+	Pure-Python twin of the native hierarchical timer wheel: four levels of
+	256/64/64/64 buckets of `tick` seconds. Arming, re-arming and cancelling
+	are O(1); advance() costs O(ticks elapsed + timers fired), cascading a
+	higher-level bucket down each time the level below wraps. A gap of 256
+	ticks or more re-files every armed timer at once instead, in O(timers).
+	"""
+	BITS = (8, 6, 6, 6)
+	
+	def __init__(self, timers, tick, start):
+		self.tick = tick
+		self.current = math.floor(start / tick)
+		self.shifts = [sum(self.BITS[:level]) for level in range(len(self.BITS))]
+		self.span = 1 << sum(self.BITS)
+		self.buckets = [[set() for _ in range(1 << bits)] for bits in self.BITS]
+		self.where = {}  # timer -> bucket set holding it
+		self.deadline = {}
+		self.due = []
+	
+	def _insert(self, timer):
+		when = self.deadline[timer]
+		if when <= self.current:
+			self.due.append(timer)
+			return
+		when = min(when, self.current + self.span - 1)
+		delta = when - self.current
+		level = 0
+		while level < len(self.BITS) - 1 and delta >= 1 << self.shifts[level + 1]:
+			level += 1
+		bucket = self.buckets[level][(when >> self.shifts[level]) & ((1 << self.BITS[level]) - 1)]
+		bucket.add(timer)
+		self.where[timer] = bucket
+	
+	def _cascade(self, level, index):
+		bucket = self.buckets[level][index]
+		timers = list(bucket)
+		bucket.clear()
+		for timer in timers:
+			del self.where[timer]
+			self._insert(timer)
+	
+	def schedule(self, timer, deadline):
+		self.cancel(timer)
+		self.deadline[timer] = math.ceil(deadline / self.tick)
+		self._insert(timer)
+	
+	def cancel(self, timer):
+		bucket = self.where.pop(timer, None)
+		if bucket is not None:
+			bucket.discard(timer)
+		if timer in self.due:
+			self.due.remove(timer)
+	
+	def advance(self, now):
+		"""Timers that came due by now, in the order they did"""
+		target = math.floor(now / self.tick)
+		if target - self.current >= 1 << self.BITS[0]:
+			armed = sorted(self.where, key=lambda timer: (self.deadline[timer], timer))
+			for timer in armed:
+				self.where.pop(timer).discard(timer)
+			self.current = target
+			for timer in armed:
+				self._insert(timer)
+		while self.current < target:
+			self.current += 1
+			tick = self.current
+			if tick & 0xFF == 0:
+				top = 1
+				while top < len(self.BITS) - 1 and (tick >> self.shifts[top]) & ((1 << self.BITS[top]) - 1) == 0:
+					top += 1
+				for level in range(top, 0, -1):
+					self._cascade(level, (tick >> self.shifts[level]) & ((1 << self.BITS[level]) - 1))
+			self._cascade(0, tick & 0xFF)
+		fired, self.due = self.due, []
+		return fired
+
+class StaleProbes:
+	"""
+	Offline deadline per probe on a timer wheel (native when libtempmon is
+	loaded): each reading re-arms its probe's timer at arrival + timeout in
+	O(1), and expire() returns exactly the probes whose deadline has passed,
+	instead of comparing every probe's lastUpdate on every line. Runs on
+	time.monotonic(), so NTP steps neither expire every probe nor stall
+	the wheel.
+	"""
+	def __init__(self, timeout=DISCONNECT_TIMEOUT, tick=STALE_TICK, slots=STALE_TIMER_SLOTS):
+		self.timeout = timeout
+		self.lock = threading.Lock()
+		self.slots = {}  # sensor_id -> timer
+		self.ids = {}  # timer -> sensor_id
+		self.free = list(range(slots - 1, -1, -1))
+		start = time.monotonic()
+		if native_engine:
+			self.wheel = native_engine.wheel_create(slots, tick, start)
+		else:
+			self.wheel = TimerWheel(slots, tick, start)
+	
+	def touch(self, sensor_id):
+		"""A reading arrived: push the probe's deadline out (ignored once all slots are used)"""
+		with self.lock:
+			timer = self.slots.get(sensor_id)
+			if timer is None:
+				if not self.free:
+					return
+				timer = self.slots[sensor_id] = self.free.pop()
+				self.ids[timer] = sensor_id
+			self.wheel.schedule(timer, time.monotonic() + self.timeout)
+	
+	def remove(self, sensor_id):
+		with self.lock:
+			self._release(sensor_id)
+	
+	def clear(self):
+		with self.lock:
+			for sensor_id in list(self.slots):
+				self._release(sensor_id)
+	
+	def _release(self, sensor_id):
+		"""Disarm one probe and free its timer (caller holds self.lock)"""
+		timer = self.slots.pop(sensor_id, None)
+		if timer is not None:
+			self.wheel.cancel(timer)
+			del self.ids[timer]
+			self.free.append(timer)
+	
+	def expire(self):
+		"""IDs of probes whose deadline has passed (their timers are released)"""
+		with self.lock:
+			expired = [self.ids[timer] for timer in self.wheel.advance(time.monotonic())]
+			for sensor_id in expired:
+				self._release(sensor_id)
+			return expired
+
+# ============================================================================
+# IN-PROCESS HEATER PID
+# ============================================================================
+
+class PidLoop:
+	"""
+	Pure-Python twin of the native PID loop (same math and metrics; its
+	timing is at the mercy of the GIL). Ticks on absolute deadlines
+	start + k * period; a tick more than a period late skips to the current
+	one and counts the missed ticks as overruns.
+	"""
+	def __init__(self, config, heater_path):
+		self.config = dict(config)
+		self.heater_path = heater_path
+		self.heater_written = None
+		self.lock = threading.Lock()
+		self.stopping = threading.Event()
+		self.feedback = None
+		self.feedback_at = 0.0
+		self.previous = None
+		self.jitter_m2 = 0.0
+		self.state = {name: 0 for name, _ in TmPidStatus._fields_}
+		self.state["output"] = self.config["out_min"]
+		self._write_heater(0)
+		self.thread = threading.Thread(target=self._run, daemon=True)
+		self.thread.start()
+	
+	def _write_heater(self, on):
+		if not self.heater_path or on == self.heater_written:
+			return
+		try:
+			with open(self.heater_path, 'w') as f:
+				f.write("1" if on else "0")
+			self.heater_written = on
+		except OSError:
+			pass  # Retried on the next change
+	
+	def _run(self):
+		start = time.monotonic()
+		deadline = start
+		while True:
+			deadline += self.config["period"]
+			if self.stopping.wait(max(deadline - time.monotonic(), 0)):
+				break
+			now = time.monotonic()
+			with self.lock:
+				period = self.config["period"]
+				late = now - deadline
+				if late > period:
+					missed = int(late / period)
+					self.state["overruns"] += missed
+					deadline += missed * period
+					late = now - deadline
+				s = self.state
+				late_us = late * 1e6
+				s["ticks"] += 1
+				delta = late_us - s["jitter_mean_us"]
+				s["jitter_mean_us"] += delta / s["ticks"]
+				self.jitter_m2 += delta * (late_us - s["jitter_mean_us"])
+				s["jitter_stddev_us"] = math.sqrt(self.jitter_m2 / (s["ticks"] - 1)) if s["ticks"] > 1 else 0.0
+				s["jitter_last_us"] = late_us
+				s["jitter_max_us"] = max(s["jitter_max_us"], late_us)
+				self._tick(now, deadline - start)
+		self.heater_written = None
+		self._write_heater(0)
+	
+	def _tick(self, now, since_start):
+		"""One PID step (caller holds self.lock)"""
+		c, s = self.config, self.state
+		dt = c["period"]
+		s["feedback_age"] = now - self.feedback_at if self.feedback is not None else 0.0
+		s["feedback_ok"] = int(self.feedback is not None and s["feedback_age"] <= c["feedback_timeout"])
+		if not s["feedback_ok"]:
+			s.update(p=0.0, i=0.0, d=0.0, output=c["out_min"], heater_on=0)
+			self.previous = None
+			self._write_heater(0)
+			return
+		
+		y = self.feedback
+		error = c["setpoint"] - y
+		s["feedback"] = y
+		s["p"] = c["kp"] * error
+		raw_d = -c["kd"] * (y - self.previous) / dt if self.previous is not None else 0.0
+		s["d"] += (dt / (c["derivative_tau"] + dt)) * (raw_d - s["d"])
+		self.previous = y
+		
+		integral = s["i"] + c["ki"] * error * dt
+		unclamped = s["p"] + integral + s["d"]
+		winding_up = (unclamped > c["out_max"] and error > 0) or (unclamped < c["out_min"] and error < 0)
+		if not winding_up:
+			s["i"] = min(max(integral, c["out_min"]), c["out_max"])
+		
+		s["output"] = min(max(s["p"] + s["i"] + s["d"], c["out_min"]), c["out_max"])
+		duty = (s["output"] - c["out_min"]) / (c["out_max"] - c["out_min"])
+		s["heater_on"] = int(math.fmod(since_start, c["window"]) < duty * c["window"])
+		self._write_heater(s["heater_on"])
+	
+	def configure(self, config):
+		with self.lock:
+			self.config = dict(config)
+	
+	def feed(self, value):
+		with self.lock:
+			self.feedback = value
+			self.feedback_at = time.monotonic()
+	
+	def status(self):
+		with self.lock:
+			status = dict(self.state)
+			if self.feedback is not None:
+				status["feedback_age"] = time.monotonic() - self.feedback_at
+			return status
+	
+	def stop(self):
+		self.stopping.set()
+		self.thread.join()
+
+class HeaterPid:
+	"""
+	Heater PID run inside this service on the configured feedback probe, fed
+	straight from ingest instead of through heating_control.py's file. The
+	loop (native thread when libtempmon is loaded) ticks on a fixed period,
+	stops integrating while saturated and time-proportions the on/off heater
+	through HEATER_GPIO_PATH. While it runs, get_temperature() reports its
+	heater state and output to the session log; the thermistor column keeps
+	the HeaterThermistorReader's own reading (NC without one), since the
+	feedback probe is already logged in its own column. Otherwise it passes
+	the reader through. Do not run heating_control.py's own loop
+	on the same heater at the same time.
+	"""
+	NUMERIC = ("setpoint", "kp", "ki", "kd", "derivative_tau", "out_min", "out_max", "period", "window", "feedback_timeout")
+	
+	def __init__(self, heater_reader, heater_path=HEATER_GPIO_PATH):
+		self.heater_reader = heater_reader
+		self.heater_path = heater_path
+		self.config = dict(PID_DEFAULTS)
+		self.loop = None
+		self.sensor_id = None  # Feedback probe while the loop runs
+		self.lock = threading.Lock()
+	
+	def configure(self, changes):
+		"""Merge and apply settings; starts or stops the loop on 'enabled' (ValueError if invalid)"""
+		config = dict(self.config)
+		for key, value in changes.items():
+			if key not in PID_DEFAULTS:
+				raise ValueError(f"Unknown PID setting '{key}'")
+			try:
+				config[key] = float(value) if key in self.NUMERIC else value
+			except (TypeError, ValueError):
+				raise ValueError(f"'{key}' must be a number")
+		config["enabled"] = bool(config["enabled"])
+		config["sensor_id"] = str(config["sensor_id"] or '').strip().lower()
+		if not (config["period"] > 0 and config["window"] >= config["period"] and config["out_max"] > config["out_min"]
+				and config["derivative_tau"] >= 0 and config["feedback_timeout"] > 0):
+			raise ValueError("Need period > 0, window >= period, out_max > out_min, derivative_tau >= 0, feedback_timeout > 0")
+		if config["enabled"] and not config["sensor_id"]:
+			raise ValueError("'sensor_id' (feedback probe) required")
+		
+		with self.lock:
+			self.config = config
+			if config["enabled"] and self.loop:
+				self.loop.configure(config)
+			elif config["enabled"]:
+				self.loop = native_engine.pid_start(config, self.heater_path) if native_engine else PidLoop(config, self.heater_path)
+				print(f"[PID] Running on {config['sensor_id']}, setpoint {config['setpoint']} °C"
+					f" ({self.heater_path or 'dry run, no heater output'})")
+			elif self.loop:
+				self._stop()
+			self.sensor_id = config["sensor_id"] if self.loop else None
+	
+	def _stop(self):
+		"""Stop the loop, heater off (caller holds self.lock)"""
+		self.loop.stop()
+		self.loop = None
+		self.sensor_id = None
+		print("[PID] Stopped, heater off")
+	
+	def stop(self):
+		with self.lock:
+			if self.loop:
+				self._stop()
+	
+	def feed(self, sensor_id, temperature):
+		"""Ingest hook: pass the feedback probe's readings to the loop"""
+		if sensor_id == self.sensor_id and temperature is not None:
+			loop = self.loop
+			if loop:
+				loop.feed(temperature)
+	
+	def status(self):
+		loop = self.loop
+		return {"config": dict(self.config), "running": loop is not None,
+			"heater_path": self.heater_path or None, "native": isinstance(loop, NativePidLoop),
+			"loop": loop.status() if loop else None}
+	
+	def get_temperature(self):
+		"""HeaterThermistorReader.get_temperature() contract, with the PID's state and output while it runs"""
+		reading = self.heater_reader.get_temperature()
+		loop = self.loop
+		if not loop:
+			return reading
+		status = loop.status()
+		return {
+			'temperature': reading['temperature'] if reading else None,
+			'heater_state': 'On' if status['heater_on'] else 'Off',
+			'pid_output': status['output'],
+			'status': 'online'
+		}
+	
+	def load(self, path=PID_CONFIG_PATH):
+		"""Apply the settings saved at path, if any"""
+		if Path(path).exists():
+			with open(path) as f:
+				self.configure(json.load(f))
+	
+	def save(self, path=PID_CONFIG_PATH):
+		with open(path, 'w') as f:
+			json.dump(self.config, f, indent=2)
+
+class FrameSchemas:
+	"""
+	ROM lists announced by each controller's SCHEMA frames, used to expand
+	positional data frames back to IDs:
+	  SCHEMA:3f1a:28abc1230000beef,28def4560000cafe
+	  @3f1a/81250:23.45,      -> [("28abc1230000beef", 23.45)], device ms 81250
+	The version is a hash of the ROM set, so it stays valid across resets.
+	The /millis part is optional (older firmware and the replay tool omit it).
+	"""
+	def __init__(self, request_interval=SCHEMA_REQUEST_INTERVAL):
+		self.request_interval = request_interval
+		self.schemas = {}  # controller -> (version, [sensor_id])
+		self.last_request = {}  # controller -> time of last SCHEMA request
+	
+	def load(self, controller, line):
+		"""Store a SCHEMA frame; returns the probe count, or None if malformed"""
+		parts = line.split(':')
+		if len(parts) != 3 or not parts[1].strip():
+			return None
+		ids = [x.strip() for x in parts[2].split(',') if x.strip()]
+		if any(not 16 <= len(x) < 24 or any(c not in "0123456789abcdefABCDEF" for c in x) for x in ids):
+			return None
+		self.schemas[controller] = (parts[1].strip(), ids)
+		return len(ids)
+	
+	def expand(self, controller, line):
+		"""
+		([(sensor_id, temperature)], device_ms or None) for a positional frame,
+		or None if the controller's schema is unknown/out of date or the frame
+		is malformed.
+		"""
+		header, sep, body = line[1:].partition(':')
+		version, _, stamp = header.partition('/')
+		schema = self.schemas.get(controller)
+		if not sep or not schema or schema[0] != version.strip():
+			return None
+		try:
+			device_ms = int(stamp) if stamp else None
+		except ValueError:
+			return None
+		cells = body.split(',')
+		if len(cells) != len(schema[1]):
+			return None  # Truncated or from another schema
+		
+		readings = []
+		for sensor_id, cell in zip(schema[1], cells):
+			cell = cell.strip()
+			if not cell:
+				continue  # Failed read (reported separately by an [ERROR] line)
+			try:
+				readings.append((sensor_id, float(cell)))
+			except ValueError:
+				return None
+		return readings, device_ms
+	
+	def should_request(self, controller):
+		"""Rate-limit SCHEMA requests to one controller"""
+		now = time.time()
+		if now - self.last_request.get(controller, 0) < self.request_interval:
+			return False
+		self.last_request[controller] = now
+		return True
+
+class ClockSync:
+	"""
+	Maps one controller's millis() onto the host clock from TIME ping-pongs:
+	  host -> TIME:<seq>             sent at t0
+	  TIME:<seq>:<millis>   <- host  received at t1
+	The device stamped the request somewhere inside [t0, t1], so each sample
+	pins device time to the midpoint within ±(t1 - t0)/2. Host time is fitted
+	as a line in device time (offset + skew) over the samples with the
+	shortest round trips, since long ones mostly measure a busy loop or a
+	queued UART. millis() wrap-around is unwrapped; a controller reset shows
+	up as a sample far off the fit and restarts the estimate.
+	"""
+	WRAP = 1 << 32
+	
+	def __init__(self, window=TIME_SYNC_WINDOW):
+		self.samples = deque(maxlen=window)  # (unwrapped device ms, host midpoint, rtt)
+		self.outstanding = None  # (seq, host send time)
+		self.seq = 0
+		self.last_sent = 0
+		self.last_raw = None  # Newest raw millis() seen, for unwrapping
+		self.device_base = 0  # Unwrapped value of last_raw
+		self.fit = None  # (device ms, host time, host seconds per device ms)
+		self.error = None  # Seconds
+		self.resets = 0
+	
+	def due(self, now):
+		"""Whether a new TIME request should go out (faster until the fit has a slope)"""
+		interval = TIME_SYNC_FAST_INTERVAL if len(self.samples) < 8 else TIME_SYNC_INTERVAL
+		return now - self.last_sent >= interval
+	
+	def request(self, now):
+		"""Next TIME command; only the newest outstanding request is matched"""
+		self.seq += 1
+		self.outstanding = (self.seq, now)
+		self.last_sent = now
+		return f"TIME:{self.seq}\n".encode()
+	
+	def on_reply(self, line, received):
+		"""Consume "TIME:<seq>:<millis>"; returns the round trip in s, or None if unmatched"""
+		parts = line.split(':')
+		if len(parts) != 3 or not self.outstanding:
+			return None
+		try:
+			seq, raw = int(parts[1]), int(parts[2])
+		except ValueError:
+			return None
+		if seq != self.outstanding[0]:
+			return None  # Stale reply to a request we gave up on
+		sent = self.outstanding[1]
+		self.outstanding = None
+		rtt = received - sent
+		midpoint = sent + rtt / 2
+		
+		device_ms = self._unwrap(raw)
+		if self.fit and abs(self._map(device_ms) - midpoint) > 1 + rtt:
+			# Controller reset (millis() restarted) or a wild fit: start over
+			self.samples.clear()
+			self.last_raw, self.device_base = raw, raw
+			device_ms = raw
+			self.resets += 1
+		self.samples.append((device_ms, midpoint, rtt))
+		self._refit()
+		return rtt
+	
+	def to_host(self, raw_ms):
+		"""Host time (epoch seconds) for a device millis() value, or None before the first sample"""
+		if not self.fit or self.last_raw is None:
+			return None
+		# Signed distance from the newest sample, so either side of a wrap works
+		delta = (raw_ms - self.last_raw + self.WRAP // 2) % self.WRAP - self.WRAP // 2
+		return self._map(self.device_base + delta)
+	
+	def status(self):
+		"""Summary for /api/system/status"""
+		if not self.fit:
+			return {"locked": False, "samples": len(self.samples)}
+		return {
+			"locked": True,
+			"samples": len(self.samples),
+			"boot_time": round(self._map(0), 3),  # Host time at device millis() = 0
+			"skew_ppm": round((self.fit[2] * 1000 - 1) * 1e6, 1),  # > 0: device clock runs slow
+			"error_ms": round(self.error * 1000, 1),
+			"resets": self.resets
+		}
+	
+	def _unwrap(self, raw):
+		if self.last_raw is not None:
+			self.device_base += (raw - self.last_raw + self.WRAP // 2) % self.WRAP - self.WRAP // 2
+		else:
+			self.device_base = raw
+		self.last_raw = raw
+		return self.device_base
+	
+	def _map(self, device_ms):
+		ref_ms, ref_host, rate = self.fit
+		return ref_host + (device_ms - ref_ms) * rate
+	
+	def _refit(self):
+		"""Least-squares line through the better half of the samples by round trip"""
+		best = sorted(self.samples, key=lambda s: s[2])[:max(2, (len(self.samples) + 1) // 2)]
+		n = len(best)
+		mean_ms = sum(s[0] for s in best) / n
+		mean_host = sum(s[1] for s in best) / n
+		spread = sum((s[0] - mean_ms) ** 2 for s in best)
+		rate = 0.001
+		if n >= 2 and spread > 0:
+			rate = sum((s[0] - mean_ms) * (s[1] - mean_host) for s in best) / spread
+			if abs(rate * 1000 - 1) > TIME_SYNC_MAX_SKEW:
+				rate = 0.001  # Too few/too close samples for a slope yet
+		self.fit = (mean_ms, mean_host, rate)
+		# Each sample is only known to ±rtt/2; the bound also covers how far
+		# the line strays from it
+		self.error = max(abs(self._map(s[0]) - s[1]) + s[2] / 2 for s in best)
+
+class TaggedCommands:
+	"""
+	Pipelined commands to the Arduinos. Each goes out as "#<id> CMD" and the
+	firmware's reply echoes the id:
+	  #12 OK Resolution changed to 9-bit
+	  #13 ERR Resolution must be 9, 10, 11, or 12
+	  #14 - PROBE 0 28be4e4348000003 mode=partial    <- more lines follow
+	  #14 OK PROBES_COMPLETE 1
+	Up to COMMAND_WINDOW commands are in flight per controller (the
+	firmware's queue depth); the rest wait here and go out as replies free
+	the window, so a batch costs about one round trip instead of one each.
+	"""
+	def __init__(self, serial_handler, window=COMMAND_WINDOW, timeout=COMMAND_TIMEOUT):
+		self.serial_handler = serial_handler
+		self.window = window
+		self.timeout = timeout
+		self.next_id = 1
+		self.in_flight = {}  # (controller, id) -> request
+		self.waiting = {}  # controller -> deque of requests not sent yet
+		self.lock = threading.Lock()
+	
+	def send(self, controller, commands):
+		"""Queue commands for one controller in order; returns their request dicts"""
+		requests = []
+		with self.lock:
+			queue = self.waiting.setdefault(controller, deque())
+			for command in commands:
+				request = {
+					"controller": controller,
+					"id": None,
+					"command": command,
+					"ok": None,
+					"reply": None,
+					"lines": [],
+					"done": threading.Event()
+				}
+				queue.append(request)
+				requests.append(request)
+			self._pump(controller)
+		return requests
+	
+	def feed(self, controller, line):
+		"""Consume a "#<id> ..." reply line; returns True if it matched a command"""
+		tag, _, rest = line[1:].partition(' ')
+		try:
+			key = (controller, int(tag))
+		except ValueError:
+			return False
+		with self.lock:
+			request = self.in_flight.get(key)
+			if request is None:
+				return False
+			kind, _, text = rest.partition(' ')
+			if kind == '-':
+				request["lines"].append(text)
+				return True
+			if kind not in ("OK", "ERR"):
+				return False
+			del self.in_flight[key]
+			request["ok"] = kind == "OK"
+			request["reply"] = text
+			request["done"].set()
+			self._pump(controller)
+		return True
+	
+	def wait(self, requests, timeout=None):
+		"""Block until every request is answered or timed out; returns result dicts"""
+		deadline = time.time() + (self.timeout if timeout is None else timeout)
+		for request in requests:
+			request["done"].wait(max(0, deadline - time.time()))
+		with self.lock:
+			for request in requests:
+				if not request["done"].is_set():
+					self._abandon(request)
+			controllers = {request["controller"] for request in requests}
+			for controller in controllers:
+				self._pump(controller)
+		return [{
+			"command": r["command"],
+			"ok": bool(r["ok"]),
+			"reply": r["reply"] if r["ok"] is not None else "timeout",
+			"lines": r["lines"]
+		} for r in requests]
+	
+	def expire(self):
+		"""Give up on commands nobody waits for that were never answered (reader thread)"""
+		now = time.time()
+		with self.lock:
+			for request in list(self.in_flight.values()):
+				if now - request["sent"] > self.timeout:
+					self._abandon(request)
+					self._pump(request["controller"])
+	
+	def _abandon(self, request):
+		"""Drop an unanswered request (caller holds self.lock)"""
+		if request["id"] is not None:
+			self.in_flight.pop((request["controller"], request["id"]), None)
+		else:
+			queue = self.waiting.get(request["controller"])
+			if queue and request in queue:
+				queue.remove(request)
+		request["done"].set()
+	
+	def _pump(self, controller):
+		"""Send waiting commands while the window has room (caller holds self.lock)"""
+		queue = self.waiting.get(controller)
+		in_flight = sum(1 for c, _ in self.in_flight if c == controller)
+		batch = []
+		while queue and in_flight < self.window:
+			request = queue.popleft()
+			request["id"] = self.next_id
+			request["sent"] = time.time()
+			self.next_id = self.next_id % 65535 + 1
+			self.in_flight[(controller, request["id"])] = request
+			batch.append(f"#{request['id']} {request['command']}\n")
+			in_flight += 1
+		if batch:
+			self.serial_handler.write_to(controller, "".join(batch).encode())
+
+class BurstCaptures:
+	"""
+	Reassembles CAPTURE dumps from the firmware:
+	  [INFO] CAPTURE_DUMP records=80 probes=2 bits=9 start_ms=51234 overwritten=0
+	  CAPTURE_ROMS:28abc1230000beef,28def4560000cafe
+	  +0:360,352          <- ms since previous record : raw 1/16 °C counts
+	  [INFO] CAPTURE_END
+	Each finished capture is kept as the latest one and saved as
+	capture_<timestamp>.csv in the log folder. Record times are mapped with
+	the controller's ClockSync when it has one, else back from the dump's
+	arrival.
+	"""
+	def __init__(self, folder, clocks=None):
+		self.folder = Path(folder)
+		self.clocks = clocks if clocks is not None else {}  # controller -> ClockSync
+		self.pending = {}  # controller -> dump being received
+		self.latest = None
+		self.lock = threading.Lock()
+	
+	def feed(self, controller, line):
+		"""Consume a line if it belongs to a capture dump; returns True if it did"""
+		if line.startswith("[INFO] CAPTURE_DUMP"):
+			fields = dict(part.split('=', 1) for part in line.split()[2:] if '=' in part)
+			self.pending[controller] = {"received": time.time(), "fields": fields, "roms": [], "records": []}
+			return True
+		
+		dump = self.pending.get(controller)
+		if dump is None:
+			return False
+		if line.startswith("CAPTURE_ROMS:"):
+			dump["roms"] = [x.strip() for x in line[13:].split(',') if x.strip()]
+		elif line.startswith("+"):
+			dump["records"].append(line)
+		elif line.startswith("[INFO] CAPTURE_END"):
+			del self.pending[controller]
+			self._finish(controller, dump)
+		else:
+			return False
+		return True
+	
+	def get_latest(self):
+		with self.lock:
+			return self.latest
+	
+	def _finish(self, controller, dump):
+		"""Decode records, place them on the host clock and save the capture"""
+		fields = dump["fields"]
+		roms = dump["roms"]
+		device_ms = int(fields.get("start_ms", 0))
+		records = []
+		for line in dump["records"]:
+			delta, _, cells = line[1:].partition(':')
+			try:
+				device_ms += int(delta)
+				temps = [int(c) / 16 if c.strip() else None for c in cells.split(',')]
+			except ValueError:
+				continue  # Garbled record: keep its time step if we got that far
+			if len(temps) == len(roms):
+				records.append((device_ms, temps))
+		
+		# The dump is sent right after the last record is taken
+		end_ms = records[-1][0] if records else device_ms
+		clock = self.clocks.get(controller)
+		def host_time(ms):
+			mapped = clock.to_host(ms % ClockSync.WRAP) if clock else None
+			return mapped if mapped is not None else dump["received"] - (end_ms - ms) / 1000
+		rows = [{
+			"timestamp": datetime.fromtimestamp(host_time(ms)).isoformat(),
+			"device_ms": ms,
+			"temperatures": temps
+		} for ms, temps in records]
+		
+		capture = {
+			"controller": controller,
+			"sensors": roms,
+			"bits": int(fields.get("bits", 0)),
+			"overwritten": int(fields.get("overwritten", 0)),
+			"rows": rows,
+			"file": None
+		}
+		
+		try:
+			filename = f"capture_{datetime.now().strftime('%Y-%m-%d_%H-%M-%S')}.csv"
+			with open(self.folder / filename, 'w') as f:
+				f.write(",".join(["Timestamp", "Device ms"] + roms) + "\n")
+				for row in rows:
+					cells = ["NC" if t is None else f"{t:.4f}" for t in row["temperatures"]]
+					f.write(",".join([row["timestamp"], str(row["device_ms"])] + cells) + "\n")
+			capture["file"] = filename
+		except OSError as e:
+			print(f"[CAPTURE] Could not save capture: {e}")
+		
+		with self.lock:
+			self.latest = capture
+		print(f"[CAPTURE] {len(rows)} records from {controller} ({len(roms)} probes, "
+			f"{capture['overwritten']} overwritten) -> {capture['file']}")
+
+def downsample_lttb(values, threshold):
+	"""Largest-Triangle-Three-Buckets over values (x = index); returns kept indices"""
+	if native_engine:
+		return native_engine.downsample(values, threshold)
+	
+	n = len(values)
+	if threshold <= 0 or n == 0:
+		return []
+	if threshold >= n or threshold < 3:
+		return list(range(min(threshold, n)))
+	
+	ys = [0.0 if v is None or v != v else v for v in values]
+	bucket_size = (n - 2) / (threshold - 2)
+	kept = [0]
+	a = 0
+	for bucket in range(threshold - 2):
+		next_begin = int((bucket + 1) * bucket_size) + 1
+		next_end = min(int((bucket + 2) * bucket_size) + 1, n)
+		avg_x = avg_y = 0.0
+		if next_end > next_begin:
+			avg_x = sum(range(next_begin, next_end)) / (next_end - next_begin)
+			avg_y = sum(ys[next_begin:next_end]) / (next_end - next_begin)
+		
+		begin = int(bucket * bucket_size) + 1
+		end = int((bucket + 1) * bucket_size) + 1
+		max_area = -1.0
+		chosen = begin
+		for i in range(begin, end):
+			area = abs((a - avg_x) * (ys[i] - ys[a]) - (a - i) * (avg_y - ys[a]))
+			if area > max_area:
+				max_area = area
+				chosen = i
+		kept.append(chosen)
+		a = chosen
+	kept.append(n - 1)
+	return kept
+
+def downsample_rows(rows, points):
+	"""Reduce session rows to about `points` rows, keeping the shape of the mean probe temperature"""
+	if not points or len(rows) <= points:
+		return rows
+	means = []
+	for row in rows:
+		# Heater columns (thermistor, state, PID output) are not sample probes
+		values = [v for column, v in row["readings"].items() if v is not None and column not in HEATER_COLUMNS]
+		means.append(sum(values) / len(values) if values else None)
+	return [rows[i] for i in downsample_lttb(means, points)]
+
+# ============================================================================
+# SESSION INDEX (SPARSE TIMESTAMP -> BYTE OFFSET SIDECAR)
+# ============================================================================
+
+class SessionIndex:
+	"""
+	Sparse time index stored next to a session CSV (temperature_log_X.idx).
+	Every SESSION_INDEX_STRIDE data rows, one line "timestamp,byte_offset" is
+	appended, so range queries can seek close to the start time instead of
+	parsing the whole file. Old sessions without a sidecar get one built on
+	first use.
+	"""
+	def __init__(self, csv_path, stride=SESSION_INDEX_STRIDE):
+		self.csv_path = Path(csv_path)
+		self.path = self.csv_path.with_suffix('.idx')
+		self.stride = stride
+		self.handle = None
+		self.rows = 0
+	
+	def open_for_append(self):
+		"""Start a fresh sidecar for a session that is being written"""
+		self.handle = open(self.path, 'w')
+		self.rows = 0
+	
+	def note_row(self, timestamp, offset):
+		"""Record a row written at byte offset; only every Nth row is indexed"""
+		if self.handle and self.rows % self.stride == 0:
+			self.handle.write(f"{timestamp},{offset}\n")
+		self.rows += 1
+	
+	def flush(self):
+		"""Write out entries; called once the rows they point at are committed"""
+		if self.handle:
+			self.handle.flush()
+	
+	def close(self):
+		"""Close the sidecar writer"""
+		if self.handle:
+			self.handle.close()
+			self.handle = None
+	
+	def load(self):
+		"""
+		Return sorted [(timestamp, offset)] entries, building the sidecar if
+		missing. Entries at or past the end of the CSV (rows lost or repaired
+		away after a crash) are dropped.
+		"""
+		if not self.path.exists():
+			self.rebuild()
+		
+		size = self.csv_path.stat().st_size
+		entries = []
+		with open(self.path, 'r') as f:
+			for line in f:
+				timestamp, _, offset = line.strip().rpartition(',')
+				try:
+					offset = int(offset)
+				except ValueError:
+					break  # Torn last line while the session is being written
+				if offset >= size:
+					break
+				entries.append((timestamp, offset))
+		return entries
+	
+	def rebuild(self):
+		"""Scan the CSV once and write a sidecar for it"""
+		with open(self.csv_path, 'rb') as f, open(self.path, 'w') as out:
+			f.readline()  # Header
+			rows = 0
+			offset = f.tell()
+			for line in iter(f.readline, b''):
+				if rows % self.stride == 0:
+					timestamp = line.split(b',', 1)[0].decode('utf-8', 'replace').strip()
+					out.write(f"{timestamp},{offset}\n")
+				rows += 1
+				offset = f.tell()
+	
+	def seek_offset(self, start):
+		"""Byte offset of the last indexed row at or before start (None = no index hit)"""
+		entries = self.load()
+		pos = bisect_right([ts for ts, _ in entries], start) - 1
+		return entries[pos][1] if pos >= 0 else None
+
+def load_session_rows(csv_path, start=None, end=None):
+	"""
+	Parse a session CSV into [{"timestamp", "readings"}], optionally limited to
+	start <= timestamp <= end (ISO 8601 strings). Uses the sidecar index to seek
+	straight to the first relevant row. Also reads .tmc session archives.
+	"""
+	if native_engine:
+		return native_engine.load_session(csv_path, start, end)
+	if is_archive(csv_path):
+		return load_archive_rows(csv_path, start, end)
+	
+	data = []
+	with open(csv_path, 'rb') as f:
+		header = f.readline().decode('utf-8', 'replace')
+		if not header:
+			return data
+		headers = header.strip().split(',')[1:]
+		
+		if start:
+			offset = SessionIndex(csv_path).seek_offset(start)
+			if offset is not None:
+				f.seek(offset)
+		
+		for raw in f:
+			values = raw.decode('utf-8', 'replace').strip().split(',')
+			if len(values) <= 1:
+				continue
+			timestamp = values[0]
+			if start and timestamp < start:
+				continue
+			if end and timestamp > end:
+				break
+			
+			readings = {}
+			for i, header in enumerate(headers):
+				try:
+					val = values[i + 1]
+					readings[header] = float(val) if val != "NC" else None
+				except (ValueError, IndexError):
+					readings[header] = None
+			
+			data.append({"timestamp": timestamp, "readings": readings})
+	return data
+
+# ============================================================================
+# SESSION ARCHIVE (COMPRESSED CHUNK STORE)
+# ============================================================================
+# Pure-Python twin of the .tmc format in native/tempmon_native.cpp (see the
+# layout there): self-contained chunks of ARCHIVE_CHUNK_ROWS rows with
+# delta-of-delta timestamps and zigzag-delta values, so a probe that holds its
+# reading costs one bit per row. Finished sessions are compacted on request
+# (POST /api/archive) and then read and downloaded like CSV sessions.
+
+ARCHIVE_MAGIC = b"TMC2"
+ARCHIVE_MAGIC_V1 = b"TMC1"  # NC and empty cells both read back as NC
+ARCHIVE_SUFFIX = ".tmc"
+ARCHIVE_EPOCH = datetime(1970, 1, 1)
+ARCHIVE_TIME_BITS = (8, 12, 20, 64)
+ARCHIVE_VALUE_BITS = (7, 16, 64)
+ARCHIVE_MAX_CHUNK_ROWS = 65535
+ARCHIVE_MAX_DIGITS = 15  # Scaled values stay exact as doubles
+ARCHIVE_TEXT, ARCHIVE_NUMERIC = 1, 0
+ARCHIVE_TIMESTAMP = re.compile(r"([0-9]{4})-([0-9]{2})-([0-9]{2})(?:T([0-9]{2}):([0-9]{2})(?::([0-9]{2})(?:\.([0-9]{1,6}))?)?)?")
+ARCHIVE_FIXED = re.compile(r"-?([0-9]+)(?:\.([0-9]{1,6}))?")
+CSV_WHITESPACE = " \t\r\n\f\v"
+
+def parse_archive_time(text):
+	"""Microseconds since the epoch of "YYYY-MM-DD[THH:MM[:SS[.ffffff]]]", or None"""
+	match = ARCHIVE_TIMESTAMP.fullmatch(text)
+	if not match:
+		return None
+	year, month, day, hour, minute, second, fraction = match.groups()
+	try:
+		moment = datetime(int(year), int(month), int(day), int(hour or 0), int(minute or 0),
+			int(second or 0), int((fraction or "0").ljust(6, "0")))
+	except ValueError:
+		return None
+	return (moment - ARCHIVE_EPOCH) // timedelta(microseconds=1)
+
+def format_archive_time(micros):
+	return (ARCHIVE_EPOCH + timedelta(microseconds=micros)).isoformat()
+
+def zigzag(value):
+	return (value << 1) ^ (value >> 63)
+
+def unzigzag(value):
+	return (value >> 1) ^ -(value & 1)
+
+class BitWriter:
+	"""MSB-first bit stream"""
+	def __init__(self):
+		self.parts = []
+		self.bits = 0
+	
+	def put(self, value, count):
+		self.parts.append(format(value & ((1 << count) - 1), f"0{count}b"))
+		self.bits += count
+	
+	def to_bytes(self):
+		bits = "".join(self.parts)
+		bits += "0" * (-len(bits) % 8)
+		return int(bits, 2).to_bytes(len(bits) // 8, 'big') if bits else b""
+
+class BitReader:
+	def __init__(self, data):
+		self.bits = format(int.from_bytes(data, 'big'), f"0{len(data) * 8}b") if data else ""
+		self.pos = 0
+	
+	def get(self, count):
+		if self.pos + count > len(self.bits):
+			raise ValueError("Truncated chunk")
+		value = int(self.bits[self.pos:self.pos + count], 2)
+		self.pos += count
+		return value
+	
+	def prefix(self):
+		"""Leading 1 bits of a code (0..4)"""
+		ones = 0
+		while ones < 4 and self.get(1):
+			ones += 1
+		return ones
+
+def put_time_code(writer, dod):
+	if dod == 0:
+		writer.put(0, 1)
+		return
+	z = zigzag(dod)
+	level = 0
+	while level < 3 and z >> ARCHIVE_TIME_BITS[level]:
+		level += 1
+	writer.put(((2 << level) - 1) << 1 if level < 3 else 0xF, level + 2 if level < 3 else 4)
+	writer.put(z, ARCHIVE_TIME_BITS[level])
+
+def put_value_code(writer, delta):
+	if delta == 0:
+		writer.put(0, 1)
+		return
+	z = zigzag(delta)
+	level = 0
+	while level < 2 and z >> ARCHIVE_VALUE_BITS[level]:
+		level += 1
+	writer.put(((2 << level) - 1) << 1, level + 2)
+	writer.put(z, ARCHIVE_VALUE_BITS[level])
+
+def format_fixed(value, decimals):
+	"""Inverse of ARCHIVE_FIXED for a column's decimals ("-0.05" for -5, 2)"""
+	if not decimals:
+		return str(value)
+	digits = str(abs(value)).rjust(decimals + 1, "0")
+	return ("-" if value < 0 else "") + digits[:-decimals] + "." + digits[-decimals:]
+
+def csv_fields(raw):
+	"""Split a CSV line the way the native reader does (bytes kept via surrogateescape)"""
+	return raw.decode('utf-8', 'surrogateescape').strip(CSV_WHITESPACE).split(',')
+
+def text_bytes(text):
+	data = text.encode('utf-8', 'surrogateescape')[:0xFFFF]
+	return len(data).to_bytes(2, 'little') + data
+
+def encode_archive_chunk(times, rows, width, report):
+	"""One chunk (length prefix included) of rows of cells"""
+	head = bytearray(len(times).to_bytes(4, 'little'))
+	head += min(times).to_bytes(8, 'little', signed=True) + max(times).to_bytes(8, 'little', signed=True)
+	
+	stream = BitWriter()
+	stream.put(times[0], 64)
+	last_delta = 0
+	for previous, current in zip(times, times[1:]):
+		put_time_code(stream, current - previous - last_delta)
+		last_delta = current - previous
+	timestamp_bits = stream.bits
+	
+	for c in range(width):
+		cells = [row[c] for row in rows]
+		present = [cell not in ("", "NC") for cell in cells]
+		matches = [ARCHIVE_FIXED.fullmatch(cell) if here else None for cell, here in zip(cells, present)]
+		numeric = all(m or not here for m, here in zip(matches, present))
+		decimals = max((len(m.group(2) or "") for m in matches if m), default=0)
+		int_digits = max((len(m.group(1)) for m in matches if m), default=0)
+		numeric = numeric and all(len(m.group(1)) + len(m.group(2) or "") <= ARCHIVE_MAX_DIGITS for m in matches if m)
+		numeric = numeric and int_digits + decimals <= ARCHIVE_MAX_DIGITS
+		if numeric:
+			codes = [int(m.group(0).replace(".", "")) if m else None for m in matches]
+			# Only cells that print back as themselves ("1.5" next to "1.25", "007" and "-0.00" do not)
+			numeric = all(code is None or format_fixed(code, decimals) == cell for code, cell in zip(codes, cells))
+		
+		if numeric:
+			head += bytes((ARCHIVE_NUMERIC, decimals))
+		else:
+			head += bytes((ARCHIVE_TEXT, 0))
+			dictionary = {}
+			codes = [dictionary.setdefault(cell, len(dictionary)) if here else None for cell, here in zip(cells, present)]
+			head += len(dictionary).to_bytes(2, 'little')
+			for entry in dictionary:
+				head += text_bytes(entry)
+		
+		last = 0
+		for code, cell in zip(codes, cells):
+			if code is None:
+				stream.put(0x1F if cell == "NC" else 0x1E, 5)
+				continue
+			put_value_code(stream, code - last)
+			last = code
+	
+	report["chunks"] += 1
+	report["timestamp_bits"] += timestamp_bits
+	report["value_bits"] += stream.bits - timestamp_bits
+	payload = bytes(head) + stream.to_bytes()
+	return len(payload).to_bytes(4, 'little') + payload
+
+def write_archive(csv_path, out_path, chunk_rows=ARCHIVE_CHUNK_ROWS):
+	"""
+	Compact a session CSV into a .tmc archive; returns the tm_archive_report
+	fields (rows, skipped, chunks, columns, source_bytes, archive_bytes,
+	timestamp_bits, value_bits). Rows with an unreadable timestamp are skipped.
+	"""
+	if chunk_rows <= 0:
+		raise ValueError("chunk_rows must be positive")
+	chunk_rows = min(chunk_rows, ARCHIVE_MAX_CHUNK_ROWS)
+	report = {"rows": 0, "skipped": 0, "chunks": 0, "columns": 0, "source_bytes": os.path.getsize(csv_path),
+		"archive_bytes": 0, "timestamp_bits": 0, "value_bits": 0}
+	
+	with open(csv_path, 'rb') as f, open(out_path, 'wb') as out:
+		header = f.readline()
+		if not header:
+			raise OSError(f"{csv_path} has no header")
+		columns = csv_fields(header)[1:]
+		width = report["columns"] = len(columns)
+		out.write(ARCHIVE_MAGIC + report["source_bytes"].to_bytes(8, 'little') + width.to_bytes(2, 'little'))
+		out.write(b"".join(text_bytes(column) for column in columns))
+		
+		times, rows = [], []
+		for raw in f:
+			fields = csv_fields(raw)
+			if len(fields) <= 1:
+				continue
+			micros = parse_archive_time(fields[0])
+			if micros is None:
+				report["skipped"] += 1
+				continue
+			times.append(micros)
+			rows.append((fields[1:] + [""] * width)[:width])
+			report["rows"] += 1
+			if len(times) == chunk_rows:
+				out.write(encode_archive_chunk(times, rows, width, report))
+				times, rows = [], []
+		if times:
+			out.write(encode_archive_chunk(times, rows, width, report))
+		report["archive_bytes"] = out.tell()
+	return report
+
+def is_archive(path):
+	with open(path, 'rb') as f:
+		return f.read(len(ARCHIVE_MAGIC)) in (ARCHIVE_MAGIC, ARCHIVE_MAGIC_V1)
+
+def read_archive_header(f):
+	"""(source CSV bytes, column names, format version) from an archive positioned at its start"""
+	fixed = f.read(len(ARCHIVE_MAGIC) + 10)
+	if len(fixed) < len(ARCHIVE_MAGIC) + 10 or fixed[:len(ARCHIVE_MAGIC)] not in (ARCHIVE_MAGIC, ARCHIVE_MAGIC_V1):
+		raise ValueError("Not a session archive")
+	columns = []
+	for _ in range(int.from_bytes(fixed[-2:], 'little')):
+		length = int.from_bytes(f.read(2), 'little')
+		columns.append(f.read(length).decode('utf-8', 'surrogateescape'))
+	return int.from_bytes(fixed[4:12], 'little'), columns, 1 if fixed.startswith(ARCHIVE_MAGIC_V1) else 2
+
+def archive_chunks(f):
+	"""Yield (rows, min time, max time, payload reader) per chunk; stops at a torn chunk"""
+	while True:
+		head = f.read(24)
+		if len(head) < 24:
+			return
+		size = int.from_bytes(head[:4], 'little')
+		if size < 20:
+			return
+		end = f.tell() + size - 20
+		yield (int.from_bytes(head[4:8], 'little'), int.from_bytes(head[8:16], 'little', signed=True),
+			int.from_bytes(head[16:24], 'little', signed=True), lambda: f.read(size - 20))
+		f.seek(end)
+
+def decode_archive_chunk(data, rows, width, version=2):
+	"""(times, columns of cells) of one chunk payload; cells are the CSV's strings"""
+	if rows <= 0:
+		raise ValueError("Empty chunk")
+	pos = 0
+	kinds = []
+	for _ in range(width):
+		kind, decimals = data[pos], data[pos + 1]
+		pos += 2
+		entries = None
+		if kind == ARCHIVE_TEXT:
+			entries = []
+			count = int.from_bytes(data[pos:pos + 2], 'little')
+			pos += 2
+			for _ in range(count):
+				length = int.from_bytes(data[pos:pos + 2], 'little')
+				entries.append(data[pos + 2:pos + 2 + length].decode('utf-8', 'surrogateescape'))
+				pos += 2 + length
+		elif kind != ARCHIVE_NUMERIC:
+			raise ValueError("Unknown column kind")
+		kinds.append((decimals, entries))
+	
+	reader = BitReader(data[pos:])
+	first = reader.get(64)
+	times = [first - (1 << 64) if first >> 63 else first]
+	delta = 0
+	for _ in range(rows - 1):
+		ones = reader.prefix()
+		if ones:
+			delta += unzigzag(reader.get(ARCHIVE_TIME_BITS[ones - 1]))
+		times.append(times[-1] + delta)
+	
+	columns = []
+	for decimals, entries in kinds:
+		cells = []
+		last = 0
+		for _ in range(rows):
+			ones = reader.prefix()
+			if ones == 4:
+				cells.append("NC" if version == 1 or reader.get(1) else "")
+				continue
+			if ones:
+				last += unzigzag(reader.get(ARCHIVE_VALUE_BITS[ones - 1]))
+			if entries is not None:
+				cells.append(entries[last] if 0 <= last < len(entries) else "")
+			else:
+				cells.append(format_fixed(last, decimals))
+		columns.append(cells)
+	return times, columns
+
+def archive_rows(path, start=None, end=None):
+	"""
+	Yield (timestamp, cells) rows of an archive with start <= timestamp <= end
+	(ISO 8601; an unreadable bound is ignored), skipping chunks outside the
+	range. Cells are the CSV's strings ("NC" and "" kept apart). A damaged
+	chunk ends the archive, as a torn row ends a CSV.
+	"""
+	start_us = parse_archive_time(start) if start else None
+	end_us = parse_archive_time(end) if end else None
+	with open(path, 'rb') as f:
+		_, columns, version = read_archive_header(f)
+		for rows, first, last, read in archive_chunks(f):
+			if (start_us is not None and last < start_us) or (end_us is not None and first > end_us):
+				continue
+			try:
+				times, cells = decode_archive_chunk(read(), rows, len(columns), version)
+			except (ValueError, IndexError):
+				return
+			for row, micros in enumerate(times):
+				if (start_us is None or micros >= start_us) and (end_us is None or micros <= end_us):
+					yield format_archive_time(micros), [column[row] for column in cells]
+
+def load_archive_rows(path, start=None, end=None):
+	"""load_session_rows() for a .tmc archive"""
+	with open(path, 'rb') as f:
+		headers = read_archive_header(f)[1]
+	data = []
+	for timestamp, cells in archive_rows(path, start, end):
+		readings = {}
+		for header, cell in zip(headers, cells):
+			try:
+				readings[header] = float(cell)
+			except ValueError:
+				readings[header] = None
+		data.append({"timestamp": timestamp, "readings": readings})
+	return data
+
+def archive_session(csv_path, delete_source=False, chunk_rows=ARCHIVE_CHUNK_ROWS):
+	"""
+	Compact a finished session CSV into temperature_log_X.tmc next to it.
+	The archive is written to a temporary name, read back and fsynced before
+	it replaces any earlier one; only then are the CSV and its .idx removed
+	(if delete_source). Returns the write report plus the compression ratio.
+	"""
+	csv_path = Path(csv_path)
+	out_path = csv_path.with_suffix(ARCHIVE_SUFFIX)
+	tmp_path = out_path.with_name(out_path.name + ".tmp")
+	try:
+		if native_engine:
+			report = native_engine.write_archive(csv_path, tmp_path, chunk_rows)
+		else:
+			report = write_archive(csv_path, tmp_path, chunk_rows)
+		
+		if native_engine:
+			stored = native_engine.count_rows(tmp_path)
+		else:
+			stored = sum(1 for _ in archive_rows(tmp_path))
+		if stored != report["rows"]:
+			raise OSError(f"Archive of {csv_path.name} reads back {stored} of {report['rows']} rows")
+		with open(tmp_path, 'rb') as f:
+			os.fsync(f.fileno())
+		os.replace(tmp_path, out_path)
+	finally:
+		tmp_path.unlink(missing_ok=True)
 	
-	def disconnect(self):
-		"""Close serial connection"""
-		if self.ser and self.ser.is_open:
-			self.ser.close()
-		self.is_connected = False
-		print("[SERIAL] Disconnected")
+	if delete_source:
+		csv_path.unlink()
+		csv_path.with_suffix('.idx').unlink(missing_ok=True)
+	
+	report["file"] = out_path.name
+	report["ratio"] = round(report["source_bytes"] / max(report["archive_bytes"], 1), 2)
+	report["bits_per_row"] = round((report["timestamp_bits"] + report["value_bits"]) / max(report["rows"], 1), 1)
+	return report
+
+def archive_summary(path):
+	"""Size report of an archive from its chunk headers (no decoding)"""
+	path = Path(path)
+	with open(path, 'rb') as f:
+		source_bytes, columns, _ = read_archive_header(f)
+		rows = chunks = 0
+		for chunk_rows, _, _, _ in archive_chunks(f):
+			rows += chunk_rows
+			chunks += 1
+	archive_bytes = path.stat().st_size
+	return {"file": path.name, "rows": rows, "chunks": chunks, "columns": len(columns),
+		"source_bytes": source_bytes, "archive_bytes": archive_bytes,
+		"ratio": round(source_bytes / max(archive_bytes, 1), 2)}
+
+def session_files(folder):
+	"""Session files in name order; an archived session's .tmc stands in for its CSV"""
+	sessions = {f.stem: f for f in folder.glob("temperature_log_*.csv")}
+	sessions.update({f.stem: f for f in folder.glob(f"temperature_log_*{ARCHIVE_SUFFIX}")})
+	return [sessions[stem] for stem in sorted(sessions)]
 
 # ============================================================================
-# SENSOR DATA MANAGER
+# SESSION ROLLUPS (MULTI-RESOLUTION TIERS)
 # ============================================================================
 
-class SensorDataManager:
+def iter_session_cells(path):
+	"""(headers, rows) of a session CSV or archive; rows yields (timestamp, cells) without loading the file"""
+	if is_archive(path):
+		with open(path, 'rb') as f:
+			headers = read_archive_header(f)[1]
+		return headers, archive_rows(path)
+	
+	with open(path, 'rb') as f:
+		headers = f.readline().decode('utf-8', 'replace').strip().split(',')[1:]
+	
+	def rows():
+		with open(path, 'rb') as f:
+			f.readline()
+			for raw in f:
+				values = raw.decode('utf-8', 'replace').strip().split(',')
+				if len(values) > 1:
+					yield values[0], values[1:]
+	return headers, rows()
+
+class SessionRollups:
 	"""
-	Manages sensor data storage, validation, and retrieval.
-	Stores current readings and historical data.
+	Rollup tiers stored next to a session (temperature_log_X.r60, .r3600):
+	for each tier in ROLLUP_TIERS, one line per bucket of that many seconds
+	with every column's count:min:max:mean. The logger feeds each row as it
+	is written and appends a bucket once the next one starts, so the tiers
+	cost O(columns) per row. Sessions without them (older or archived ones)
+	get them built on first use.
 	"""
-	def __init__(self):
-		self.sensors = {}
-		self.history = {}
-		self.lock = threading.Lock()
-		self.mock_sensor_counter = 0
+	def __init__(self, session_path, tiers=ROLLUP_TIERS):
+		self.session_path = Path(session_path)
+		self.tiers = tiers
+		self.handles = {}
+		self.buckets = {}  # tier -> [bucket number, per column [count, min, max, sum]]
 	
-	def update_sensor(self, sensor_id, temperature, status="online"):
-		"""Update sensor reading"""
-		with self.lock:
-			if sensor_id not in self.sensors:
-				# Generate better name for mock sensors
-				if sensor_id.startswith('280000'):
-					self.mock_sensor_counter += 1
-					name = f"Mock Probe {self.mock_sensor_counter}"
+	def path(self, tier):
+		return self.session_path.with_suffix(f".r{tier}")
+	
+	def open_for_append(self, header, suffix=""):
+		"""Start fresh tiers for a session that is being written; header is its CSV header line"""
+		for tier in self.tiers:
+			self.handles[tier] = open(str(self.path(tier)) + suffix, 'w')
+			self.handles[tier].write(header + "\n")
+			self.handles[tier].flush()
+		self.buckets = {}
+	
+	def add(self, micros, cells):
+		"""Fold one row (µs timestamp, cells after the timestamp) into the open bucket of every tier"""
+		values = []
+		for cell in cells:
+			try:
+				value = float(cell) if cell is not None and cell != "NC" else None
+			except ValueError:
+				value = None
+			values.append(value if value == value else None)  # NaN counts as missing
+		
+		for tier in self.tiers:
+			number = micros // (tier * 1000000)
+			bucket = self.buckets.get(tier)
+			if bucket and bucket[0] != number:
+				self._write_bucket(tier, bucket)
+				bucket = None
+			if not bucket:
+				bucket = self.buckets[tier] = [number, []]
+			columns = bucket[1]
+			while len(columns) < len(values):
+				columns.append([0, None, None, 0.0])
+			for column, value in zip(columns, values):
+				if value is None:
+					continue
+				if not column[0]:
+					column[1] = column[2] = value
 				else:
-					name = f"Probe {sensor_id[:8]}"
-				
-				self.sensors[sensor_id] = {
-					"temperature": temperature,
-					"status": status,
-					"lastUpdate": time.time(),
-					"name": name
-				}
-			else:
-				self.sensors[sensor_id]["temperature"] = temperature
-				self.sensors[sensor_id]["status"] = status
-				self.sensors[sensor_id]["lastUpdate"] = time.time()
+					column[1] = min(column[1], value)
+					column[2] = max(column[2], value)
+				column[0] += 1
+				column[3] += value
 	
-	def set_offline(self, sensor_id):
-		"""Mark sensor as offline"""
-		with self.lock:
-			if sensor_id in self.sensors:
-				self.sensors[sensor_id]["status"] = "offline"
+	def _write_bucket(self, tier, bucket):
+		number, columns = bucket
+		cells = [f"{count}:{low}:{high}:{round(total / count, 4)}" if count else "0"
+			for count, low, high, total in columns]
+		self.handles[tier].write(",".join([format_archive_time(number * tier * 1000000)] + cells) + "\n")
 	
-	def add_to_history(self, sensor_id, temperature, timestamp=None):
-		"""Add reading to history"""
-		with self.lock:
-			if sensor_id not in self.history:
-				self.history[sensor_id] = []
-			self.history[sensor_id].append({
-				"temperature": temperature,
-				"timestamp": timestamp or time.time()
-			})
+	def flush(self):
+		"""Write out finished buckets; called once their rows are committed"""
+		for handle in self.handles.values():
+			handle.flush()
 	
-	def get_sensors(self):
-		"""Get all sensor data"""
-		with self.lock:
-			return dict(self.sensors)
+	def close(self):
+		"""Write the open buckets and close the tier files"""
+		for tier, bucket in self.buckets.items():
+			self._write_bucket(tier, bucket)
+		self.buckets = {}
+		for handle in self.handles.values():
+			handle.close()
+		self.handles = {}
 	
-	def get_history(self):
-		"""Get historical data"""
-		with self.lock:
-			return dict(self.history)
+	def rebuild(self):
+		"""Roll up the whole session once and write its tiers"""
+		headers, rows = iter_session_cells(self.session_path)
+		builder = SessionRollups(self.session_path, self.tiers)
+		suffix = f".{threading.get_ident()}.tmp"  # Concurrent first requests each build their own
+		builder.open_for_append(",".join(["Timestamp"] + headers), suffix)
+		try:
+			for timestamp, cells in rows:
+				micros = parse_archive_time(timestamp)
+				if micros is not None:
+					builder.add(micros, cells)
+		finally:
+			builder.close()
+		for tier in self.tiers:
+			os.replace(str(self.path(tier)) + suffix, self.path(tier))
 	
-	def rename_sensor(self, sensor_id, name):
-		"""Rename a sensor"""
-		with self.lock:
-			if sensor_id in self.sensors:
-				self.sensors[sensor_id]["name"] = name
-				print(f"[SENSOR] Renamed {sensor_id} to '{name}'")
-				return True
-			return False
+	def span(self, start=None, end=None):
+		"""Seconds of the session within [start, end], from the finest tier (None if empty)"""
+		tier = min(self.tiers)
+		path = self.path(tier)
+		if not path.exists():
+			self.rebuild()
+		with open(path, 'rb') as f:
+			f.readline()
+			first = f.readline()
+			f.seek(0, os.SEEK_END)
+			f.seek(max(0, f.tell() - 4096))
+			tail = f.read()
+		lines = tail.split(b'\n')[:-1]  # Drop a torn or empty last piece
+		if not first.endswith(b'\n') or not lines:
+			return None
+		
+		low = parse_archive_time(first.split(b',', 1)[0].decode())
+		high = parse_archive_time(lines[-1].split(b',', 1)[0].decode('utf-8', 'replace'))
+		if low is None or high is None:
+			return None
+		high += tier * 1000000
+		bound = parse_archive_time(start) if start else None
+		low = max(low, bound) if bound is not None else low
+		bound = parse_archive_time(end) if end else None
+		high = min(high, bound) if bound is not None else high
+		return (high - low) / 1e6 if high > low else None
 	
-	def delete_sensor(self, sensor_id):
-		"""Delete a sensor from tracking"""
-		with self.lock:
-			if sensor_id in self.sensors:
-				name = self.sensors[sensor_id]["name"]
-				del self.sensors[sensor_id]
-				# Also remove from history if exists
-				if sensor_id in self.history:
-					del self.history[sensor_id]
-				print(f"[SENSOR] Deleted {sensor_id} ({name})")
-				return True
-			return False
+	def load(self, tier, start=None, end=None):
+		"""
+		Buckets of one tier overlapping [start, end] as session rows (readings =
+		means, plus "min", "max" and "count" per column), and the µs time where
+		the tier stops covering the session (None if it has no buckets).
+		"""
+		path = self.path(tier)
+		if not path.exists():
+			self.rebuild()
+		# Bucket times are written in one fixed form, so bounds compare as strings
+		start_us = parse_archive_time(start) if start else None
+		end_us = parse_archive_time(end) if end else None
+		after = format_archive_time(start_us - tier * 1000000) if start_us is not None else None
+		until = format_archive_time(end_us) if end_us is not None else None
+		
+		rows = []
+		last = None
+		with open(path, 'r', encoding='utf-8', errors='replace') as f:
+			headers = f.readline().rstrip('\n').split(',')[1:]
+			for line in f:
+				if not line.endswith('\n'):
+					break  # Torn last line while the session is being written
+				fields = line[:-1].split(',')
+				last = fields[0]
+				if after is not None and last <= after:
+					continue
+				if until is not None and last > until:
+					break
+				
+				means, lows, highs, counts = {}, {}, {}, {}
+				for header, cell in zip(headers, fields[1:]):
+					parts = cell.split(':')
+					if len(parts) == 4:
+						counts[header] = int(parts[0])
+						lows[header], highs[header], means[header] = float(parts[1]), float(parts[2]), float(parts[3])
+					else:
+						counts[header] = 0
+						lows[header] = highs[header] = means[header] = None
+				rows.append({"timestamp": last, "readings": means, "min": lows, "max": highs, "count": counts})
+		
+		covered = parse_archive_time(last) if last else None
+		if covered is not None:
+			covered += tier * 1000000
+		return rows, covered
+
+def load_graph_rows(session_path, start=None, end=None, points=None, resolution=None):
+	"""
+	Rows of one session for a chart, and the rollup tier they came from (0 =
+	raw rows). Uses the coarsest tier in ROLLUP_TIERS no wider than
+	resolution seconds per row (by default the span of the range / points);
+	rows after the tier's last bucket, e.g. of a session still being logged,
+	are read raw.
+	"""
+	rollups = SessionRollups(session_path)
+	if not resolution and points:
+		span = rollups.span(start, end)
+		resolution = span / points if span else None
+	tiers = [tier for tier in ROLLUP_TIERS if resolution and tier <= resolution]
+	if not tiers:
+		return load_session_rows(session_path, start, end), 0
 	
-	def detect_disconnected(self, current_ids, timeout=30):
-		"""Detect sensors that haven't reported recently"""
-		with self.lock:
-			current_time = time.time()
-			for sensor_id in self.sensors:
-				if sensor_id not in current_ids:
-					last_update = self.sensors[sensor_id]["lastUpdate"]
-					if current_time - last_update > timeout:
-						self.sensors[sensor_id]["status"] = "offline"
+	tier = max(tiers)
+	rows, covered = rollups.load(tier, start, end)
+	if covered is None:
+		return load_session_rows(session_path, start, end), 0
+	start_us = parse_archive_time(start) if start else None
+	tail_start = format_archive_time(max(covered, start_us) if start_us is not None else covered)
+	return rows + load_session_rows(session_path, tail_start, end), tier
 
 # ============================================================================
 # DATA LOGGER (MODIFIED TO INCLUDE HEATER STATE)
 # ============================================================================
 
+def recover_torn_tail(csv_path):
+	"""
+	Cut a partially written last row (power loss mid-write) back to the last
+	complete line. Filesystems may also leave NUL padding there. Returns True
+	if the file was repaired; its .idx and rollup sidecars are then dropped
+	and rebuilt on next use.
+	"""
+	csv_path = Path(csv_path)
+	size = csv_path.stat().st_size
+	if size == 0:
+		return False
+	
+	with open(csv_path, 'rb+') as f:
+		tail_start = max(0, size - 4096)
+		f.seek(tail_start)
+		tail = f.read()
+		if tail.endswith(b'\n'):
+			return False
+		
+		cut = tail.rstrip(b'\0').rfind(b'\n')
+		if cut < 0 and tail_start > 0:
+			return False  # No newline in the last 4 KiB: not a torn row, leave it alone
+		f.truncate(tail_start + cut + 1)
+	
+	csv_path.with_suffix('.idx').unlink(missing_ok=True)
+	for tier in ROLLUP_TIERS:
+		csv_path.with_suffix(f".r{tier}").unlink(missing_ok=True)
+	print(f"[LOGGER] Recovered torn tail of {csv_path.name} ({size - (tail_start + cut + 1)} bytes dropped)")
+	return True
+
 class DataLogger:
 	"""
 	Handles CSV file creation and data logging with proper timestamps.
 	NOW INCLUDES HEATER THERMISTOR TEMPERATURE AND STATE IN CSV!
+	
+	Each session file is an append-only log. Rows are buffered and group
+	committed (flush + fsync) every LOG_COMMIT_INTERVAL seconds instead of
+	flushed one by one, which keeps SD-card writes down; torn tails left by a
+	power loss are repaired when the folder is opened.
 	"""
-	def __init__(self, folder=LOG_FOLDER):
-		self.folder = Path(folder)
-		self.folder.mkdir(parents=True, exist_ok=True)
+	def __init__(self, folder=LOG_FOLDER, commit_interval=LOG_COMMIT_INTERVAL):
+		self.commit_interval = commit_interval
 		self.current_file = None
 		self.current_handle = None
+		self.current_index = None
+		self.current_rollups = None
+		self.current_offset = 0
+		self.last_commit = 0
+		self.uncommitted_rows = 0
+		self.last_row_time = 0
 		self.lock = threading.Lock()
 		self.sensor_mapping = {}
+		self.open_folder(folder)
+	
+	def open_folder(self, folder):
+		"""
+		Log the next sessions to folder, repairing torn tails left there.
+		The reader thread and the API share this one logger, so a new folder
+		is switched to in place rather than with a new DataLogger.
+		"""
+		folder = Path(folder)
+		folder.mkdir(parents=True, exist_ok=True)
+		with self.lock:
+			if self.current_handle:
+				raise RuntimeError(f"Session {self.current_file.name} is still open")
+			self.folder = folder
+		
+		for csv_file in folder.glob("temperature_log_*.csv"):
+			try:
+				recover_torn_tail(csv_file)
+			except OSError as e:
+				print(f"[LOGGER] Could not check {csv_file.name}: {e}")
+	
+	def _commit(self):
+		"""Flush buffered rows and fsync them (caller holds self.lock)"""
+		self.current_handle.flush()
+		os.fsync(self.current_handle.fileno())
+		# Sidecars follow, so they never point past the rows on disk
+		self.current_index.flush()
+		self.current_rollups.flush()
+		self.last_commit = time.time()
+		self.uncommitted_rows = 0
+	
+	def commit_if_due(self):
+		"""Group commit if rows are pending and the commit interval has passed"""
+		with self.lock:
+			if self.current_handle and self.uncommitted_rows and time.time() - self.last_commit >= self.commit_interval:
+				try:
+					self._commit()
+				except Exception as e:
+					print(f"[LOGGER] Error committing rows: {e}")
 	
 	def start_session(self, sensors):
 		"""Create new logging session file with sensor names in headers"""
@@ -386,6 +3187,8 @@ class DataLogger:
 			try:
 				self.current_handle = open(filepath, 'w')
 				self.current_file = filepath
+				self.current_index = SessionIndex(filepath)
+				self.current_index.open_for_append()
 				
 				# Store sensor mapping for later use
 				self.sensor_mapping = {sid: (s["name"], sid) for sid, s in sensors.items()}
@@ -398,13 +3201,14 @@ class DataLogger:
 					header_parts.append(column_header)
 				
 				# Add heater thermistor columns (temperature and state)
-				header_parts.append("Heater Thermistor (°C)")
-				header_parts.append("Heater State")
-				header_parts.append("PID Output") 
+				header_parts.extend(HEATER_COLUMNS)
 				
 				header = ",".join(header_parts)
 				self.current_handle.write(header + "\n")
-				self.current_handle.flush()
+				self.current_rollups = SessionRollups(filepath)
+				self.current_rollups.open_for_append(header)
+				self.current_offset = len((header + "\n").encode(self.current_handle.encoding))
+				self._commit()
 				
 				print(f"[LOGGER] Started new session: {filename}")
 				print(f"[LOGGER] Logging to: {filepath}")
@@ -416,14 +3220,21 @@ class DataLogger:
 				print(f"[LOGGER] Error starting session: {e}")
 				return None
 	
-	def log_reading(self, sensors_dict, heater_temp=None, heater_state=None, pid_output=None):
-		"""Log current sensor readings plus heater temperature and state"""
+	def log_reading(self, sensors_dict, heater_temp=None, heater_state=None, pid_output=None, timestamp=None):
+		"""
+		Log current sensor readings plus heater temperature and state.
+		timestamp: host time the readings were taken (device clock mapped by
+		ClockSync); defaults to now. Rows never go back in time, so the
+		session index stays sorted when a fit is refined.
+		"""
 		with self.lock:
 			if not self.current_handle:
 				return False
 			
 			try:
-				timestamp = datetime.now().isoformat()
+				row_time = max(timestamp or time.time(), self.last_row_time)
+				self.last_row_time = row_time
+				timestamp = datetime.fromtimestamp(row_time).isoformat()
 				row = timestamp
 				
 				# Log sample probes in same order as header
@@ -455,8 +3266,14 @@ class DataLogger:
 					pid_value = "NC"
 				row += f",{pid_value}"
 
+				self.current_index.note_row(timestamp, self.current_offset)
+				self.current_rollups.add(parse_archive_time(timestamp), row.split(",")[1:])
 				self.current_handle.write(row + "\n")
-				self.current_handle.flush()
+				self.current_offset += len((row + "\n").encode(self.current_handle.encoding))
+				self.uncommitted_rows += 1
+				
+				if time.time() - self.last_commit >= self.commit_interval:
+					self._commit()
 				
 				return True
 			
@@ -469,9 +3286,14 @@ class DataLogger:
 		with self.lock:
 			if self.current_handle:
 				try:
+					self._commit()
 					self.current_handle.close()
+					self.current_index.close()
+					self.current_rollups.close()
 					filename = self.current_file.name
 					self.current_handle = None
+					self.current_index = None
+					self.current_rollups = None
 					self.current_file = None
 					self.sensor_mapping = {}
 					print(f"[LOGGER] Session ended: {filename}")
@@ -481,36 +3303,17 @@ class DataLogger:
 					return None
 			return None
 	
-	def load_session_data(self, filename):
-		"""Load data from a specific session file"""
+	def load_session_data(self, filename, start=None, end=None):
+		"""Load data from a specific session file, optionally within [start, end]"""
 		try:
 			filepath = self.folder / filename
 			if not filepath.exists():
 				print(f"[LOGGER] File not found: {filepath}")
 				return None
 			
-			data = []
-			with open(filepath, 'r') as f:
-				lines = f.readlines()
-				if not lines:
-					return None
-				
-				headers = lines[0].strip().split(',')[1:]
-				
-				for line in lines[1:]:
-					values = line.strip().split(',')
-					if len(values) > 1:
-						timestamp = values[0]
-						readings = {}
-						
-						for i, header in enumerate(headers):
-							try:
-								val = values[i + 1]
-								readings[header] = float(val) if val != "NC" else None
-							except (ValueError, IndexError):
-								readings[header] = None
-						
-						data.append({"timestamp": timestamp, "readings": readings})
+			data = load_session_rows(filepath, start, end)
+			if not data:
+				return None
 			
 			print(f"[LOGGER] Loaded {len(data)} rows from {filename}")
 			return data
@@ -532,7 +3335,7 @@ class SerialReaderThread(threading.Thread):
 	Continuously reads from Arduino and updates sensor data.
 	Now with improved message handling and Serial Monitor support.
 	"""
-	def __init__(self, serial_handler, data_manager, state_machine, logger, message_queue, heater_reader):
+	def __init__(self, serial_handler, data_manager, state_machine, logger, message_queue, heater_reader, heater_pid=None):
 		super().__init__(daemon=True)
 		self.serial_handler = serial_handler
 		self.data_manager = data_manager
@@ -540,8 +3343,12 @@ class SerialReaderThread(threading.Thread):
 		self.logger = logger
 		self.message_queue = message_queue
 		self.heater_reader = heater_reader
+		self.heater_pid = heater_pid  # In-process PID fed with its probe's readings
 		self.running = True
-		self.disconnect_timeout = 30
+		self.schemas = FrameSchemas()
+		self.clocks = {}  # controller -> ClockSync
+		self.captures = BurstCaptures(logger.folder, self.clocks)
+		self.commands = TaggedCommands(serial_handler)
 	
 	def run(self):
 		"""Main thread loop"""
@@ -558,18 +3365,71 @@ class SerialReaderThread(threading.Thread):
 				else:
 					self.state_machine.set_state(SystemState.READING)
 			
-			# Read data from Arduino
-			line = self.serial_handler.read_line()
+			self._sync_clocks()
+			self.commands.expire()
+			self._post_alerts()
+			self.data_manager.expire_stale()
+			
+			# Read data from whichever Arduino has a line ready (waits briefly if idle)
+			controller, line = self.serial_handler.read_tagged()
 			if not line:
-				time.sleep(0.1)
 				continue
 			
 			# Log raw data to Serial Monitor
-			self.message_queue.add(line, "raw")
+			self.message_queue.add(line, "raw", controller=controller)
 			
 			try:
 				current_ids = set()
-				readings = line.split(',')
+				
+				# CAPTURE dumps arrive as a block after the capture ends
+				if self.captures.feed(controller, line):
+					continue
+				
+				# Replies to tagged commands, matched by their "#<id>"
+				if line.startswith("#") and self.commands.feed(controller, line):
+					continue
+				
+				# Reply to our clock ping-pong
+				if line.startswith("TIME:"):
+					self._on_time(controller, line)
+					continue
+				
+				# Rate-of-change trigger with the probe's pre-trigger history
+				if line.startswith("TRIG:"):
+					self._on_trigger(controller, line)
+					continue
+				
+				# ROM list for this controller's positional frames
+				if line.startswith("SCHEMA:"):
+					count = self.schemas.load(controller, line)
+					if count is None:
+						self.message_queue.add(f"Malformed schema frame: {line}", "warning", controller=controller)
+					else:
+						self.message_queue.add(f"Schema {line.split(':')[1]}: {count} probes", "info", controller=controller)
+					continue
+				
+				# Positional frames are expanded via the schema; plain data lines take
+				# the fast path (native parser when available). Frames stamped with
+				# the device clock are placed on the host clock once it is synced.
+				timestamp = None
+				if line.startswith("@"):
+					expanded = self.schemas.expand(controller, line)
+					if expanded is None:
+						self._on_unknown_schema(controller, line)
+						continue
+					parsed, device_ms = expanded
+					clock = self.clocks.get(controller)
+					if device_ms is not None and clock:
+						timestamp = clock.to_host(device_ms)
+				else:
+					parsed = parse_data_line(line)
+				if parsed is not None:
+					for sensor_id, temp in parsed:
+						current_ids.add(sensor_id)
+						self._handle_reading(sensor_id, temp, f"{sensor_id}:{temp:.2f}", controller, timestamp)
+					readings = []
+				else:
+					readings = line.split(',')
 				
 				for reading in readings:
 					reading = reading.strip()
@@ -606,22 +3466,7 @@ class SerialReaderThread(threading.Thread):
 							current_ids.add(sensor_id)
 							
 							try:
-								temp = float(temp_str)
-								self.data_manager.update_sensor(sensor_id, temp, "online")
-								self.message_queue.add(reading, "temperature")
-								
-								# Log if currently logging (MODIFIED: Include heater state)
-								if self.state_machine.logging_state == LoggingState.LOGGING:
-									heater_temp = None
-									heater_state = None
-									pid_output = None
-									heater_data = self.heater_reader.get_temperature()
-									if heater_data:
-										heater_temp = heater_data['temperature']
-										heater_state = heater_data.get('heater_state', 'Unknown')
-										pid_output = heater_data.get('pid_output')
-									
-									self.logger.log_reading(self.data_manager.get_sensors(), heater_temp, heater_state, pid_output)
+								self._handle_reading(sensor_id, float(temp_str), reading, controller)
 							
 							except ValueError:
 								msg = f"Invalid temperature value: {temp_str}"
@@ -651,19 +3496,100 @@ class SerialReaderThread(threading.Thread):
 						self.message_queue.add(reading, "unknown")
 						print(f"[ARDUINO_UNKNOWN] {reading}")
 				
+				# One session row per frame, not one per probe
+				if current_ids:
+					self._log_frame(timestamp)
+				
 				# Update state if needed
 				if self.state_machine.current_state == SystemState.WAITING_FOR_SERIAL:
 					self.state_machine.set_state(SystemState.READING)
-				
-				# Detect disconnected sensors
-				self.data_manager.detect_disconnected(current_ids, self.disconnect_timeout)
 			
 			except Exception as e:
 				msg = f"Parse error: {e}"
 				self.message_queue.add(msg, "error")
 				print(f"[READER] {msg}")
+	
+	def _sync_clocks(self):
+		"""Send a TIME ping to every attached controller that is due one"""
+		now = time.time()
+		for controller in self.serial_handler.get_controllers():
+			clock = self.clocks.setdefault(controller, ClockSync())
+			if clock.due(now):
+				self.serial_handler.write_to(controller, clock.request(now))
+	
+	def _on_time(self, controller, line):
+		"""Feed a TIME reply, timed by when it came off the tty"""
+		clock = self.clocks.get(controller)
+		received = self.serial_handler.last_received or time.time()
+		if not clock or clock.on_reply(line, received) is None:
+			self.message_queue.add(f"Unmatched clock reply: {line}", "warning", controller=controller)
+	
+	def _post_alerts(self):
+		"""Drain alert events raised at ingest (or by staleness) into the message queue"""
+		for event in self.data_manager.alerts.check():
+			msg = f"Alert {event['rule']} {event['state']}: {event['sensor_id']} {event['type']} {event['value']}"
+			self.message_queue.add(msg, "alert" if event["state"] == "raised" else "info", timestamp=event["timestamp"])
+			print(f"[ALERT] {msg}")
+	
+	def get_clock_status(self):
+		"""ClockSync summary per controller"""
+		return {controller: clock.status() for controller, clock in list(self.clocks.items())}
+	
+	def _on_unknown_schema(self, controller, line):
+		"""Drop a positional frame we can't map and ask for the schema again"""
+		msg = f"Dropped positional frame (unknown schema or truncated): {line[:40]}"
+		self.message_queue.add(msg, "warning", controller=controller)
+		if self.schemas.should_request(controller):
+			print(f"[READER] {msg}; requesting schema from {controller}")
+			self.serial_handler.write_to(controller, b"SCHEMA\n")
+	
+	def _on_trigger(self, controller, line):
+		"""
+		TRIG:<rom>:<slope 1/100 °C/s>:<cycle ms>:<oldest>,...,<newest>
+		The probe is now sampled fast; the history holds the poll cycles the
+		firmware withheld before the trigger, placed back one cycle apart.
+		"""
+		parts = line.split(':')
+		if len(parts) != 5:
+			self.message_queue.add(f"Malformed trigger: {line}", "warning", controller=controller)
+			return
+		try:
+			sensor_id = parts[1]
+			slope = int(parts[2]) / 100
+			cycle = int(parts[3]) / 1000
+			history = [float(x) for x in parts[4].split(',') if x.strip()]
+		except ValueError:
+			self.message_queue.add(f"Malformed trigger: {line}", "warning", controller=controller)
+			return
+		
+		now = time.time()
+		for age, temp in enumerate(reversed(history), start=1):
+			self.message_queue.add(f"{sensor_id}:{temp:.2f}", "temperature", timestamp=now - age * cycle, controller=controller)
+		msg = f"Trigger {sensor_id}: {slope:+.2f} °C/s, fast sampling ({len(history)} pre-trigger readings)"
+		self.message_queue.add(msg, "info", controller=controller)
+		print(f"[TRIGGER] {msg}")
+	
+	def _handle_reading(self, sensor_id, temp, reading, controller, timestamp=None):
+		"""Store one validated probe reading (timestamp: host time it was taken, if known)"""
+		self.data_manager.update_sensor(sensor_id, temp, "online", controller, timestamp)
+		if self.heater_pid:
+			self.heater_pid.feed(sensor_id, temp)
+		self.message_queue.add(reading, "temperature", timestamp=timestamp, controller=controller)
+	
+	def _log_frame(self, timestamp=None):
+		"""Log one row for the whole frame if a session is running"""
+		# Log if currently logging (MODIFIED: Include heater state)
+		if self.state_machine.logging_state == LoggingState.LOGGING:
+			heater_temp = None
+			heater_state = None
+			pid_output = None
+			heater_data = (self.heater_pid or self.heater_reader).get_temperature()
+			if heater_data:
+				heater_temp = heater_data['temperature']
+				heater_state = heater_data.get('heater_state', 'Unknown')
+				pid_output = heater_data.get('pid_output')
 			
-			time.sleep(0.1)
+			self.logger.log_reading(self.data_manager.get_sensors(), heater_temp, heater_state, pid_output, timestamp)
 	
 	def stop(self):
 		"""Stop the reader thread"""
@@ -720,6 +3646,8 @@ class LoggingThread(threading.Thread):
 
 				last_log = current_time
 			
+			self.logger.commit_if_due()
+			
 			time.sleep(0.5)
 	
 	def stop(self):
@@ -740,10 +3668,14 @@ data_manager = SensorDataManager()
 logger = DataLogger()
 serial_message_queue = SerialMessageQueue(max_messages=100)
 heater_reader = HeaterThermistorReader()
+heater_pid = HeaterPid(heater_reader)  # Passes heater_reader through while the PID is off
 
 # Global logging thread
 logging_thread = None
 
+# Global serial reader thread (owns frame schemas and burst captures)
+reader_thread = None
+
 
 
 # ============================================================================
@@ -757,18 +3689,92 @@ def index():
 
 @app.route('/api/sensors', methods=['GET'])
 def get_sensors():
-	"""Get all current sensor readings"""
-	sensors = data_manager.get_sensors()
+	"""Get all current sensor readings (lock-free from the shared table when available)"""
+	sensors = data_manager.latest_table.snapshot() if data_manager.latest_table else None
+	if sensors is None:
+		sensors = data_manager.get_sensors()  # No table, more probes than slots, or a slot stayed busy
 	return jsonify({"sensors": sensors})
 
+@app.route('/api/sensors/stats', methods=['GET'])
+def get_sensor_stats():
+	"""
+	Rolling statistics per probe (EWMA, and mean/stddev/slope/min/max over
+	each of STATS_WINDOWS), kept up to date at ingest so this is O(1) per probe.
+	Optional ?sensor_id= returns one probe.
+	"""
+	sensor_id = request.args.get('sensor_id', '').strip()
+	if sensor_id:
+		stats = data_manager.stats.get(sensor_id)
+		if stats is None:
+			return jsonify({"error": "Sensor not found"}), 404
+		return jsonify({"windows": list(data_manager.stats.windows), "stats": {sensor_id: stats}})
+	with data_manager.stats.lock:
+		untracked = sorted(data_manager.stats.untracked)
+	return jsonify({"windows": list(data_manager.stats.windows), "stats": data_manager.stats.snapshot(), "untracked": untracked})
+
+@app.route('/api/alerts', methods=['GET'])
+def get_alerts():
+	"""Alert rules, currently raised alerts and recent alert events"""
+	return jsonify(data_manager.alerts.status())
+
+@app.route('/api/alerts/rules', methods=['POST'])
+def set_alert_rules():
+	"""
+	Replace the alert rule set (compiled and saved to ALERT_RULES_PATH).
+	Body: {"rules": [{"id": "oven-high", "type": "above", "sensor_id": "28...", "limit": 80}, ...]}
+	"""
+	data = request.get_json() or {}
+	rules = data.get('rules')
+	if not isinstance(rules, list):
+		return jsonify({"error": "Missing parameters"}), 400
+	try:
+		data_manager.alerts.set_rules(rules)
+	except ValueError as e:
+		return jsonify({"error": str(e)}), 400
+	try:
+		data_manager.alerts.save()
+	except OSError as e:
+		print(f"[ALERT] Could not save rules to {ALERT_RULES_PATH}: {e}")
+	return jsonify({"status": "ok", "rules": len(rules)})
+
+@app.route('/api/pid', methods=['GET'])
+def get_pid():
+	"""In-process heater PID: settings, state and loop-jitter metrics"""
+	return jsonify(heater_pid.status())
+
+@app.route('/api/pid', methods=['POST'])
+def set_pid():
+	"""
+	Change PID settings (any subset of PID_DEFAULTS) and save them.
+	Body: {"enabled": true, "sensor_id": "28...", "setpoint": 45, "kp": 0.2}
+	"""
+	data = request.get_json() or {}
+	try:
+		heater_pid.configure(data)
+	except ValueError as e:
+		return jsonify({"error": str(e)}), 400
+	try:
+		heater_pid.save()
+	except OSError as e:
+		print(f"[PID] Could not save settings to {PID_CONFIG_PATH}: {e}")
+	return jsonify(heater_pid.status())
+
 @app.route('/api/probes/rescan', methods=['POST'])
 def rescan_probes():
 	"""Trigger Arduino to rescan for probes"""
 	try:
-		if serial_handler.ser and serial_handler.ser.is_open:
-			serial_handler.ser.write(b"RESCAN\n")
+		if reader_thread:
+			# All controllers rescan in parallel; wait for each one's ack
+			requests = []
+			for controller in serial_handler.get_controllers():
+				requests += reader_thread.commands.send(controller, ["RESCAN"])
+			results = reader_thread.commands.wait(requests)
+			replies = {r["controller"]: result["reply"] for r, result in zip(requests, results)}
+		else:
+			serial_handler.write_all(b"RESCAN\n")
+			replies = {}
 		sensors = data_manager.get_sensors()
-		return jsonify({"status": "ok", "sensors": sensors})
+		return jsonify({"status": "ok", "sensors": sensors, "replies": replies})
 	except Exception as e:
 		return jsonify({"error": str(e)}), 500
 
@@ -817,10 +3823,50 @@ def delete_probe():
 		print(f"[API] Delete error: {e}")
 		return jsonify({"error": str(e)}), 500
 
+@app.route('/api/probes/read', methods=['POST'])
+def read_probe():
+	"""
+	Fresh reading of one probe, converted on its own ahead of the poll cycle.
+	Body: {"sensor_id": "28abc1230000beef", "bits": 9}; bits omitted = 9 (~94 ms conversion)
+	"""
+	data = request.get_json() or {}
+	sensor_id = (data.get('sensor_id') or '').strip().lower()
+	try:
+		bits = int(data.get('bits') or 9)
+	except ValueError:
+		bits = 0
+	if not sensor_id or not 9 <= bits <= 12 or not reader_thread:
+		return jsonify({"error": "Missing parameters"}), 400
+	sensor = data_manager.get_sensors().get(sensor_id)
+	if not sensor or sensor.get("controller") not in serial_handler.get_controllers():
+		return jsonify({"error": "Sensor not found"}), 404
+	
+	controller = sensor["controller"]
+	started = time.time()
+	result = reader_thread.commands.wait(reader_thread.commands.send(controller, [f"READ:{sensor_id},{bits}"]))[0]
+	round_trip_ms = round((time.time() - started) * 1000, 1)
+	
+	# "READ <rom> <temp> bits=9 conv_ms=95 latency_ms=97" (or "<rom> failed ...")
+	words = result["reply"].split()
+	fields = dict(w.split('=', 1) for w in words if '=' in w)
+	if not result["ok"] or len(words) < 3 or words[2] == "failed":
+		return jsonify({"error": result["reply"], "round_trip_ms": round_trip_ms}), 502
+	temperature = float(words[2])
+	data_manager.update_sensor(sensor_id, temperature, "online", controller)
+	return jsonify({
+		"status": "ok",
+		"sensor_id": sensor_id,
+		"temperature": temperature,
+		"bits": int(fields.get("bits", bits)),
+		"conv_ms": int(fields.get("conv_ms", 0)),
+		"latency_ms": int(fields.get("latency_ms", 0)),
+		"round_trip_ms": round_trip_ms
+	})
+
 @app.route('/api/logging/start', methods=['POST'])
 def start_logging():
 	"""Start data logging session"""
-	global logging_thread, logger
+	global logging_thread
 	
 	if not state_machine.can_start_logging():
 		return jsonify({"error": "System not ready for logging"}), 400
@@ -834,7 +3880,7 @@ def start_logging():
 		# Validate and create folder
 		if not folder:
 			folder = LOG_FOLDER
-		logger = DataLogger(folder)
+		logger.open_folder(folder)
 		
 		sensors = data_manager.get_sensors()
 		filename = logger.start_session(sensors)
@@ -842,7 +3888,7 @@ def start_logging():
 		if not filename:
 			return jsonify({"error": "Failed to create log file"}), 500
 		
-		logging_thread = LoggingThread(data_manager, logger, state_machine, heater_reader, duration, interval)
+		logging_thread = LoggingThread(data_manager, logger, state_machine, heater_pid, duration, interval)
 		logging_thread.start()
 		
 		state_machine.set_logging_state(LoggingState.LOGGING)
@@ -864,7 +3910,7 @@ def start_logging():
 @app.route('/api/logging/stop', methods=['POST'])
 def stop_logging():
 	"""Stop current logging session"""
-	global logging_thread, logger
+	global logging_thread
 	
 	try:
 		if logging_thread and logging_thread.running:
@@ -892,7 +3938,11 @@ def get_graph_data():
 		log_folder.mkdir(parents=True, exist_ok=True)
 		
 		requested_file = request.args.get('file')
-		csv_files = sorted(log_folder.glob("temperature_log_*.csv"))
+		start = request.args.get('start')  # ISO 8601, inclusive
+		end = request.args.get('end')
+		points = request.args.get('points', type=int)  # Downsample each session to ~N rows
+		resolution = request.args.get('resolution', type=float)  # Seconds per row the chart needs
+		csv_files = session_files(log_folder)
 		
 		if not csv_files:
 			return jsonify({"sessions": {}, "files": []})
@@ -901,73 +3951,223 @@ def get_graph_data():
 		
 		if requested_file:
 			requested_path = log_folder / requested_file
+			if not requested_path.exists():
+				requested_path = requested_path.with_suffix(ARCHIVE_SUFFIX)  # Session archived since it was listed
 			if requested_path.exists():
 				csv_files = [requested_path]
 			else:
 				csv_files = []
 		
 		sessions = {}
+		tiers = {}
 		
 		for csv_file in csv_files:
-			data = []
 			try:
-				with open(csv_file, "r") as f:
-					lines = f.readlines()
-					if not lines:
-						continue
-					
-					headers = lines[0].strip().split(",")[1:]
-					
-					for line in lines[1:]:
-						values = line.strip().split(",")
-						if len(values) > 1:
-							timestamp = values[0]
-							readings = {}
-							
-							for i, header in enumerate(headers):
-								try:
-									val = values[i + 1]
-									readings[header] = float(val) if val != "NC" else None
-								except (ValueError, IndexError):
-									readings[header] = None
-							
-							data.append({"timestamp": timestamp, "readings": readings})
-				
+				data, tier = load_graph_rows(csv_file, start, end, points, resolution)
 				if data:
-					sessions[csv_file.name] = data
+					sessions[csv_file.name] = downsample_rows(data, points)
+					tiers[csv_file.name] = tier
 			
 			except Exception as e:
 				print(f"[GRAPHS] Error loading {csv_file.name}: {e}")
 		
-		return jsonify({"sessions": sessions, "files": files_list})
+		return jsonify({"sessions": sessions, "files": files_list, "tiers": tiers})
 	
 	except Exception as e:
 		return jsonify({"error": str(e)}), 500
 
 @app.route('/api/graphs/download', methods=['GET'])
 def download_graph_csv():
-	"""Download historical data as CSV"""
+	"""Download historical data as CSV, streamed session by session"""
 	try:
 		log_folder = Path(LOG_FOLDER)
 		log_folder.mkdir(parents=True, exist_ok=True)
 		
-		csv_files = sorted(log_folder.glob("temperature_log_*.csv"))
+		csv_files = session_files(log_folder)
 		
 		if not csv_files:
 			return jsonify({"error": "No data available"}), 404
 		
-		combined_file = log_folder / "combined_export.csv"
+		return Response(stream_combined_csv(csv_files), mimetype='text/csv',
+			headers={"Content-Disposition": "attachment; filename=temperature_data.csv"})
+	
+	except Exception as e:
+		return jsonify({"error": str(e)}), 500
+
+def stream_combined_csv(csv_files, chunk_size=64 * 1024):
+	"""
+	Yield all sessions as one CSV with a single unified header.
+	Columns are the union of every session's probe columns in first-seen
+	order, followed by the heater columns; a session that lacks a column gets
+	an empty cell. Sessions whose header
+	already matches are copied in fixed-size chunks without parsing, so
+	memory stays constant regardless of archive size. Archived (.tmc)
+	sessions are decoded chunk by chunk.
+	"""
+	session_headers = []
+	columns = []
+	for csv_file in csv_files:
+		with open(csv_file, 'rb') as f:
+			if is_archive(csv_file):
+				header = ["Timestamp"] + read_archive_header(f)[1]
+			else:
+				header = f.readline().decode('utf-8', 'replace').strip().split(',')
+		session_headers.append(header)
+		for column in header[1:]:
+			if column not in columns and column not in HEATER_COLUMNS:
+				columns.append(column)
+	columns += HEATER_COLUMNS
+	
+	unified = ["Timestamp"] + columns
+	yield (",".join(unified) + "\n").encode('utf-8')
+	
+	for csv_file, header in zip(csv_files, session_headers):
+		if is_archive(csv_file):
+			positions = [columns.index(c) + 1 for c in header[1:]]
+			for timestamp, cells in archive_rows(csv_file):
+				row = [""] * len(unified)
+				row[0] = timestamp
+				for pos, cell in zip(positions, cells):
+					row[pos] = cell
+				yield (",".join(row) + "\n").encode('utf-8', 'surrogateescape')
+			continue
+		
+		with open(csv_file, 'rb') as f:
+			f.readline()
+			
+			if header[1:] == columns:
+				chunk = b''
+				for chunk in iter(lambda: f.read(chunk_size), b''):
+					yield chunk
+				if chunk and not chunk.endswith(b'\n'):
+					yield b'\n'  # Torn last row; keep the next session on its own line
+				continue
+			
+			# Map this session's columns onto the unified layout
+			positions = [columns.index(c) + 1 for c in header[1:]]
+			for raw in f:
+				values = raw.decode('utf-8', 'replace').rstrip('\r\n').split(',')
+				if len(values) <= 1:
+					continue
+				row = [""] * len(unified)
+				row[0] = values[0]
+				for pos, val in zip(positions, values[1:]):
+					row[pos] = val
+				yield (",".join(row) + "\n").encode('utf-8')
+
+@app.route('/api/archive', methods=['GET'])
+def get_archive():
+	"""Compression report of every archived session"""
+	try:
+		archives = []
+		for path in sorted(Path(LOG_FOLDER).glob(f"temperature_log_*{ARCHIVE_SUFFIX}")):
+			try:
+				archives.append(archive_summary(path))
+			except (OSError, ValueError) as e:
+				print(f"[ARCHIVE] Error reading {path.name}: {e}")
+		
+		source_bytes = sum(a["source_bytes"] for a in archives)
+		archive_bytes = sum(a["archive_bytes"] for a in archives)
+		return jsonify({"archives": archives, "source_bytes": source_bytes, "archive_bytes": archive_bytes,
+			"ratio": round(source_bytes / archive_bytes, 2) if archive_bytes else None})
+	
+	except Exception as e:
+		return jsonify({"error": str(e)}), 500
+
+@app.route('/api/archive', methods=['POST'])
+def archive_sessions():
+	"""
+	Compact finished session CSVs into .tmc archives. Body (optional):
+	{"file": "temperature_log_X.csv", "delete_csv": false}. Without a file,
+	every session that has no archive yet is compacted; the session being
+	logged is never touched.
+	"""
+	try:
+		data = request.get_json(silent=True) or {}
+		log_folder = Path(LOG_FOLDER)
+		delete_csv = bool(data.get('delete_csv', False))
+		
+		if data.get('file'):
+			csv_files = [log_folder / Path(data['file']).name]
+			if not csv_files[0].exists() or csv_files[0].suffix != '.csv':
+				return jsonify({"error": f"No session CSV {data['file']}"}), 404
+		else:
+			csv_files = [f for f in sorted(log_folder.glob("temperature_log_*.csv"))
+				if not f.with_suffix(ARCHIVE_SUFFIX).exists()]
 		
-		with open(combined_file, 'w') as outfile:
-			for csv_file in csv_files:
-				with open(csv_file, 'r') as infile:
-					outfile.write(infile.read())
+		active = logger.current_file
+		archived = []
+		errors = []
+		for csv_file in csv_files:
+			if active and csv_file == active:
+				errors.append({"file": csv_file.name, "error": "Session is being logged"})
+				continue
+			try:
+				report = archive_session(csv_file, delete_csv)
+				archived.append(report)
+				print(f"[ARCHIVE] {csv_file.name} -> {report['file']}: {report['rows']} rows, "
+					f"{report['source_bytes']} -> {report['archive_bytes']} bytes ({report['ratio']}x)")
+			except (OSError, ValueError) as e:
+				errors.append({"file": csv_file.name, "error": str(e)})
 		
-		return send_file(combined_file, as_attachment=True, download_name="temperature_data.csv")
+		return jsonify({"status": "success" if not errors else "partial", "archived": archived, "errors": errors})
 	
 	except Exception as e:
 		return jsonify({"error": str(e)}), 500
 
+@app.route('/api/capture', methods=['POST'])
+def start_capture():
+	"""
+	Start a 9-bit burst capture on up to 4 probes of one controller.
+	Body: {"sensor_ids": [...], "duration_ms": 5000}; duration_ms omitted = until the buffer is full
+	"""
+	data = request.get_json() or {}
+	sensor_ids = data.get('sensor_ids') or []
+	duration_ms = int(data.get('duration_ms') or 0)
+	if not sensor_ids or not reader_thread:
+		return jsonify({"error": "Missing parameters"}), 400
+	
+	# Positions come from the controller's schema (firmware probe order)
+	for controller, (version, ids) in list(reader_thread.schemas.schemas.items()):
+		if all(sid in ids for sid in sensor_ids):
+			positions = "+".join(str(ids.index(sid)) for sid in sensor_ids)
+			command = f"CAPTURE:{positions}" + (f",{duration_ms}" if duration_ms > 0 else "")
+			result = reader_thread.commands.wait(reader_thread.commands.send(controller, [command]))[0]
+			if not result["ok"]:
+				return jsonify({"error": result["reply"], "controller": controller, "command": command}), 502
+			return jsonify({"status": "ok", "controller": controller, "command": command, "reply": result["reply"]})
+	return jsonify({"error": "Sensors not found on one controller (schema frames required)"}), 404
+
+@app.route('/api/controllers/commands', methods=['POST'])
+def controller_commands():
+	"""
+	Send a batch of firmware commands, pipelined, and return every reply.
+	Body: {"commands": ["RESOLUTION:9", "TRIGGER:50,4", "STATUS"], "controller": "ttyACM0"}
+	controller omitted = every attached controller
+	"""
+	data = request.get_json() or {}
+	commands = [str(c).strip() for c in data.get('commands') or [] if str(c).strip()]
+	if not commands or not reader_thread:
+		return jsonify({"error": "Missing parameters"}), 400
+	controllers = serial_handler.get_controllers()
+	if data.get('controller'):
+		if data['controller'] not in controllers:
+			return jsonify({"error": "Controller not found"}), 404
+		controllers = [data['controller']]
+	
+	# Every controller's batch is in flight at once
+	batches = {c: reader_thread.commands.send(c, commands) for c in controllers}
+	results = {c: reader_thread.commands.wait(requests) for c, requests in batches.items()}
+	return jsonify({"status": "ok", "results": results})
+
+@app.route('/api/capture', methods=['GET'])
+def get_capture():
+	"""Latest finished burst capture"""
+	capture = reader_thread.captures.get_latest() if reader_thread else None
+	if not capture:
+		return jsonify({"error": "No capture yet"}), 404
+	return jsonify(capture)
+
 @app.route('/api/mock/enable', methods=['POST'])
 def enable_mock_mode():
 	"""Enable mock mode"""
@@ -987,7 +4187,7 @@ def disable_mock_mode():
 	global serial_handler, data_manager
 	try:
 		serial_handler.use_mock = False
-		data_manager.sensors.clear()
+		data_manager.clear()
 		msg = "Mock mode DISABLED - waiting for Arduino"
 		serial_message_queue.add(msg, "info")
 		print(f"[MOCK] {msg}")
@@ -1017,6 +4217,8 @@ def system_status():
 		"logging_state": logging_state.value,
 		"error": error,
 		"serial_connected": serial_handler.is_connected,
+		"controllers": serial_handler.get_controllers(),
+		"clock_sync": reader_thread.get_clock_status() if reader_thread else {},
 		"mock_mode": serial_handler.use_mock
 	})
 
@@ -1030,14 +4232,38 @@ def startup_sequence():
 	print(f"[STARTUP] Log folder: {LOG_FOLDER}")
 	print("[STARTUP] Serial Message Queue: 100 messages max")
 	print("[STARTUP] CSV logging: Now includes sensor names, heater temperature, AND heater state!")
-	print("[STARTUP] Heater thermistor source: /tmp/heater_thermistor.json")
+	print(f"[STARTUP] Heater thermistor source: {HEATER_SOCKET_PATH} (fallback /tmp/heater_thermistor.json)")
 	print("[STARTUP] JSON format: {\"temperature_c\": float, \"heater_state\": \"On\"|\"Off\", \"timestamp\": float}")
 	print("[STARTUP] Probe management: Includes DELETE functionality!")
 	
 	Path(LOG_FOLDER).mkdir(parents=True, exist_ok=True)
 	
-	reader = SerialReaderThread(serial_handler, data_manager, state_machine, logger, serial_message_queue, heater_reader)
-	reader.start()
+	try:
+		data_manager.latest_table = LatestValueTable.create()
+		print(f"[STARTUP] Latest-value table: {LATEST_TABLE_PATH} ({LATEST_TABLE_SLOTS} probes)")
+	except Exception as e:
+		print(f"[STARTUP] Latest-value table unavailable ({e}); /api/sensors reads under lock")
+	
+	try:
+		print(f"[STARTUP] Alert rules: {data_manager.alerts.load()} from {ALERT_RULES_PATH}")
+	except (OSError, ValueError) as e:
+		print(f"[STARTUP] Ignoring alert rules in {ALERT_RULES_PATH}: {e}")
+	
+	heater_reader.start_listener()
+	
+	try:
+		heater_pid.load()
+	except (OSError, ValueError) as e:
+		print(f"[STARTUP] Ignoring PID settings in {PID_CONFIG_PATH}: {e}")
+	atexit.register(heater_pid.stop)  # Heater off on exit
+	# atexit does not run on a fatal signal; turn systemd's SIGTERM (and
+	# Ctrl+C) into a normal exit so the heater is switched off
+	for signum in (signal.SIGTERM, signal.SIGINT):
+		signal.signal(signum, lambda *_: sys.exit(0))
+	
+	global reader_thread
+	reader_thread = SerialReaderThread(serial_handler, data_manager, state_machine, logger, serial_message_queue, heater_reader, heater_pid)
+	reader_thread.start()
 	
 	print("[STARTUP] Serial reader thread started")
 	print("[STARTUP] System ready")
@@ -0,0 +1,1667 @@
+// Temperature Monitoring System - native engine
+// C ABI implementation of the parser, session store reader and archive,
+// downsampler and rolling statistics used by app_heat.py. See tempmon_native.h for the
+// interface contract.
+
+#include "tempmon_native.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// STRING HELPERS
+// ============================================================================
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+}
+
+// Trim [begin, end) in place
+static void trim(const char*& begin, const char*& end) {
+  while (begin < end && isSpace(*begin)) begin++;
+  while (end > begin && isSpace(end[-1])) end--;
+}
+
+static bool isHex(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// Parse the whole of [begin, end) as a double; false if anything is left over
+static bool parseDouble(const char* begin, const char* end, double& value) {
+  trim(begin, end);
+  if (begin == end) return false;
+  std::string token(begin, end);
+  char* stop = nullptr;
+  value = std::strtod(token.c_str(), &stop);
+  return stop == token.c_str() + token.size();
+}
+
+static bool readLine(FILE* f, std::string& line) {
+  line.clear();
+  char buffer[512];
+  while (std::fgets(buffer, sizeof(buffer), f)) {
+    line += buffer;
+    if (!line.empty() && line.back() == '\n') break;
+  }
+  return !line.empty();
+}
+
+static void splitCommas(const std::string& line, std::vector<std::string>& out) {
+  out.clear();
+  const char* begin = line.c_str();
+  const char* end = begin + line.size();
+  trim(begin, end);
+  const char* field = begin;
+  for (const char* p = begin; ; p++) {
+    if (p == end || *p == ',') {
+      out.emplace_back(field, p);
+      if (p == end) break;
+      field = p + 1;
+    }
+  }
+}
+
+// ============================================================================
+// SERIAL LINE PARSER
+// ============================================================================
+
+extern "C" int tm_abi_version(void) {
+  return TM_ABI_VERSION;
+}
+
+extern "C" int tm_parse_line(const char* line, tm_reading* out, int max_out) {
+  if (!line || !out) return -1;
+
+  int count = 0;
+  const char* p = line;
+  while (true) {
+    const char* begin = p;
+    while (*p && *p != ',') p++;
+    const char* end = p;
+    trim(begin, end);
+
+    if (begin != end) {
+      const char* colon = static_cast<const char*>(std::memchr(begin, ':', end - begin));
+      if (!colon || std::memchr(colon + 1, ':', end - colon - 1)) return -1;
+
+      // Real DS18B20 IDs are 16 hex chars starting with 28, or mock format 280000...
+      const char* idBegin = begin;
+      const char* idEnd = colon;
+      trim(idBegin, idEnd);
+      long idLength = idEnd - idBegin;
+      if (idLength < 16 || idLength >= TM_ID_MAX) return -1;
+      for (const char* c = idBegin; c < idEnd; c++) {
+        if (!isHex(*c)) return -1;
+      }
+
+      double temperature;
+      if (!parseDouble(colon + 1, end, temperature)) return -1;
+      if (count >= max_out) return -1;
+
+      std::memcpy(out[count].id, idBegin, idLength);
+      out[count].id[idLength] = '\0';
+      out[count].temperature = temperature;
+      count++;
+    }
+
+    if (!*p) break;
+    p++;
+  }
+  return count;
+}
+
+// ============================================================================
+// SESSION STORE READER
+// ============================================================================
+
+struct tm_session {
+  std::vector<std::string> columns;
+  std::vector<std::string> timestamps;
+  std::vector<double> values;
+  mutable std::string joinedTimestamps;  // Built on first tm_session_timestamps() call
+};
+
+// Byte offset of the last indexed row at or before start, or -1. Entries at
+// or past csvSize point at rows a crash lost, so the scan stops there.
+static long indexedOffset(const char* csvPath, const std::string& start, long csvSize) {
+  std::string idxPath(csvPath);
+  size_t dot = idxPath.find_last_of('.');
+  size_t slash = idxPath.find_last_of('/');
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+    idxPath.erase(dot);
+  }
+  idxPath += ".idx";
+
+  FILE* f = std::fopen(idxPath.c_str(), "rb");
+  if (!f) return -1;
+
+  long offset = -1;
+  std::string line;
+  while (readLine(f, line)) {
+    size_t comma = line.find_last_of(',');
+    if (comma == std::string::npos) break;
+    char* stop = nullptr;
+    long entryOffset = std::strtol(line.c_str() + comma + 1, &stop, 10);
+    if (stop == line.c_str() + comma + 1) break;  // Torn last line
+    if (entryOffset >= csvSize || line.compare(0, comma, start) > 0) break;
+    offset = entryOffset;
+  }
+  std::fclose(f);
+  return offset;
+}
+
+static int archiveVersion(FILE* f);
+static void loadArchive(FILE* f, int version, tm_session* session, const char* start, const char* end);
+
+extern "C" tm_session* tm_session_open(const char* path, const char* start, const char* end) {
+  if (!path) return nullptr;
+  FILE* f = std::fopen(path, "rb");
+  if (!f) return nullptr;
+
+  tm_session* session = new tm_session();
+  std::string line;
+  std::vector<std::string> fields;
+
+  int version = archiveVersion(f);
+  if (version) {
+    loadArchive(f, version, session, start, end);
+  } else if (readLine(f, line)) {
+    splitCommas(line, fields);
+    session->columns.assign(fields.begin() + 1, fields.end());
+
+    std::string startKey = start ? start : "";
+    std::string endKey = end ? end : "";
+    if (!startKey.empty()) {
+      long position = std::ftell(f);
+      std::fseek(f, 0, SEEK_END);
+      long offset = indexedOffset(path, startKey, std::ftell(f));
+      std::fseek(f, offset >= 0 ? offset : position, SEEK_SET);
+    }
+
+    const double missing = std::numeric_limits<double>::quiet_NaN();
+    size_t width = session->columns.size();
+    while (readLine(f, line)) {
+      splitCommas(line, fields);
+      if (fields.size() <= 1) continue;
+
+      const std::string& timestamp = fields[0];
+      if (!startKey.empty() && timestamp < startKey) continue;
+      if (!endKey.empty() && timestamp > endKey) break;
+
+      session->timestamps.push_back(timestamp);
+      for (size_t i = 0; i < width; i++) {
+        double value = missing;
+        if (i + 1 < fields.size()) {
+          const std::string& cell = fields[i + 1];
+          if (cell == "NC" || !parseDouble(cell.data(), cell.data() + cell.size(), value)) {
+            value = missing;
+          }
+        }
+        session->values.push_back(value);
+      }
+    }
+  }
+
+  std::fclose(f);
+  return session;
+}
+
+extern "C" void tm_session_close(tm_session* session) {
+  delete session;
+}
+
+extern "C" int tm_session_columns(const tm_session* session) {
+  return session ? static_cast<int>(session->columns.size()) : 0;
+}
+
+extern "C" const char* tm_session_column(const tm_session* session, int column) {
+  if (!session || column < 0 || column >= static_cast<int>(session->columns.size())) return nullptr;
+  return session->columns[column].c_str();
+}
+
+extern "C" long tm_session_rows(const tm_session* session) {
+  return session ? static_cast<long>(session->timestamps.size()) : 0;
+}
+
+extern "C" const char* tm_session_timestamp(const tm_session* session, long row) {
+  if (!session || row < 0 || row >= static_cast<long>(session->timestamps.size())) return nullptr;
+  return session->timestamps[row].c_str();
+}
+
+extern "C" const char* tm_session_timestamps(const tm_session* session) {
+  if (!session) return nullptr;
+  if (session->joinedTimestamps.empty()) {
+    for (size_t i = 0; i < session->timestamps.size(); i++) {
+      if (i) session->joinedTimestamps += '\n';
+      session->joinedTimestamps += session->timestamps[i];
+    }
+  }
+  return session->joinedTimestamps.c_str();
+}
+
+extern "C" const double* tm_session_values(const tm_session* session) {
+  return (session && !session->values.empty()) ? session->values.data() : nullptr;
+}
+
+// ============================================================================
+// SESSION ARCHIVE (COMPRESSED CHUNK STORE)
+// ============================================================================
+//
+// A .tmc file is the CSV header followed by self-contained chunks of up to
+// chunk_rows rows (integers little-endian):
+//
+//   "TMC2" | u64 CSV bytes | u16 columns | per column: u16 length, name
+//   chunk: u32 bytes that follow | u32 rows | i64 min time | i64 max time |
+//          per column: u8 kind, u8 decimals [text: u16 entries, per entry
+//          u16 length, bytes] | bit stream, padded to a byte
+//
+// The bit stream holds the first timestamp (64 bits), one delta-of-delta
+// code per further row, then each column in turn, so an unchanged probe
+// costs one bit per row:
+//
+//   timestamps (zigzag dod, µs)    values (zigzag delta to last present value)
+//   0                  dod = 0     0                   same value
+//   10   + 8 bits                  10   + 7 bits
+//   110  + 12 bits                 110  + 16 bits
+//   1110 + 20 bits                 1110 + 64 bits
+//   1111 + 64 bits                 1111 + 1 bit        missing: 0 empty, 1 NC
+//
+// Numeric columns are integers scaled by 10^decimals, used only when every
+// cell of the column prints back as itself; "1.5" next to "1.25", "007" or
+// "-0.00" make that chunk's column a text column, whose codes are indices
+// into the chunk's dictionary. So every cell reads back as the same text;
+// timestamps read back in datetime.isoformat() form. The min/max time in
+// each chunk header let range reads skip a chunk without decoding it.
+// "TMC1" archives had a bare 1111 for both NC and empty cells.
+
+namespace {
+
+const char kArchiveMagic[4] = {'T', 'M', 'C', '2'};
+const char kArchiveMagicV1[4] = {'T', 'M', 'C', '1'};
+const int kArchiveMaxDecimals = 6;
+const int kArchiveMaxDigits = 15;  // Scaled values stay exact as doubles
+const long kArchiveMaxChunkRows = 65535;
+const unsigned char kColumnNumeric = 0;
+const unsigned char kColumnText = 1;
+const int kTimeBits[4] = {8, 12, 20, 64};
+const int kValueBits[3] = {7, 16, 64};
+const long long kMicrosPerDay = 86400LL * 1000000LL;
+
+struct BitWriter {
+  std::vector<unsigned char> bytes;
+  long bits = 0;
+
+  void put(unsigned long long value, int count) {
+    while (count > 0) {
+      int offset = bits % 8;
+      if (offset == 0) bytes.push_back(0);
+      int take = std::min(8 - offset, count);
+      unsigned chunk = static_cast<unsigned>(value >> (count - take)) & ((1u << take) - 1);
+      bytes.back() |= static_cast<unsigned char>(chunk << (8 - offset - take));
+      bits += take;
+      count -= take;
+    }
+  }
+};
+
+struct BitReader {
+  const unsigned char* data;
+  long bits;
+  long pos = 0;
+
+  BitReader(const unsigned char* data, long bytes) : data(data), bits(bytes * 8) {}
+
+  bool get(int count, unsigned long long& value) {
+    if (pos + count > bits) return false;
+    value = 0;
+    while (count > 0) {
+      int offset = pos % 8;
+      int take = std::min(8 - offset, count);
+      unsigned chunk = (data[pos / 8] >> (8 - offset - take)) & ((1u << take) - 1);
+      value = (value << take) | chunk;
+      pos += take;
+      count -= take;
+    }
+    return true;
+  }
+
+  // Leading 1 bits of a code (0..4); -1 past the end
+  int prefix() {
+    int ones = 0;
+    unsigned long long bit;
+    while (ones < 4) {
+      if (!get(1, bit)) return -1;
+      if (!bit) break;
+      ones++;
+    }
+    return ones;
+  }
+};
+
+unsigned long long zigzag(long long v) {
+  return (static_cast<unsigned long long>(v) << 1) ^ static_cast<unsigned long long>(v >> 63);
+}
+
+long long unzigzag(unsigned long long z) {
+  return static_cast<long long>(z >> 1) ^ -static_cast<long long>(z & 1);
+}
+
+void putTimeCode(BitWriter& w, long long dod) {
+  if (dod == 0) {
+    w.put(0, 1);
+    return;
+  }
+  unsigned long long z = zigzag(dod);
+  int level = 0;
+  while (level < 3 && z >> kTimeBits[level]) level++;
+  w.put(level < 3 ? ((2u << level) - 1) << 1 : 0xF, level < 3 ? level + 2 : 4);
+  w.put(z, kTimeBits[level]);
+}
+
+bool getTimeCode(BitReader& r, long long& dod) {
+  int ones = r.prefix();
+  if (ones < 0) return false;
+  if (ones == 0) {
+    dod = 0;
+    return true;
+  }
+  unsigned long long z;
+  if (!r.get(kTimeBits[ones - 1], z)) return false;
+  dod = unzigzag(z);
+  return true;
+}
+
+void putValueCode(BitWriter& w, long long delta) {
+  if (delta == 0) {
+    w.put(0, 1);
+    return;
+  }
+  unsigned long long z = zigzag(delta);
+  int level = 0;
+  while (level < 2 && z >> kValueBits[level]) level++;
+  w.put(((2u << level) - 1) << 1, level + 2);
+  w.put(z, kValueBits[level]);
+}
+
+// 1 = delta, 0 = missing, -1 = past the end; version 1 has no NC/empty bit
+int getValueCode(BitReader& r, int version, long long& delta) {
+  int ones = r.prefix();
+  if (ones < 0) return -1;
+  if (ones == 4) {
+    unsigned long long nc;
+    return version == 1 || r.get(1, nc) ? 0 : -1;
+  }
+  if (ones == 0) {
+    delta = 0;
+    return 1;
+  }
+  unsigned long long z;
+  if (!r.get(kValueBits[ones - 1], z)) return -1;
+  delta = unzigzag(z);
+  return 1;
+}
+
+void putLE(std::vector<unsigned char>& out, unsigned long long value, int bytes) {
+  for (int i = 0; i < bytes; i++) out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+}
+
+unsigned long long getLE(const unsigned char* p, int bytes) {
+  unsigned long long value = 0;
+  for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | p[i];
+  return value;
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar
+long long daysFromCivil(int y, int m, int d) {
+  y -= m <= 2;
+  long long era = (y >= 0 ? y : y - 399) / 400;
+  long long yoe = y - era * 400;
+  long long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+void civilFromDays(long long z, int& y, int& m, int& d) {
+  z += 719468;
+  long long era = (z >= 0 ? z : z - 146096) / 146097;
+  long long doe = z - era * 146097;
+  long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  long long mp = (5 * doy + 2) / 153;
+  d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+  m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+  y = static_cast<int>(yoe + era * 400 + (m <= 2));
+}
+
+bool readDigits(const char*& p, const char* end, int count, int& value) {
+  value = 0;
+  for (int i = 0; i < count; i++, p++) {
+    if (p == end || *p < '0' || *p > '9') return false;
+    value = value * 10 + (*p - '0');
+  }
+  return true;
+}
+
+// "YYYY-MM-DD[THH:MM[:SS[.ffffff]]]" (naive local time) to µs since the epoch
+bool parseTimestamp(const char* p, const char* end, long long& micros) {
+  static const int monthDays[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  int year, month, day, hour = 0, minute = 0, second = 0, fraction = 0;
+  if (!readDigits(p, end, 4, year) || p == end || *p++ != '-') return false;
+  if (!readDigits(p, end, 2, month) || p == end || *p++ != '-') return false;
+  if (!readDigits(p, end, 2, day)) return false;
+  if (p != end) {
+    if (*p++ != 'T' || !readDigits(p, end, 2, hour) || p == end || *p++ != ':') return false;
+    if (!readDigits(p, end, 2, minute)) return false;
+    if (p != end) {
+      if (*p++ != ':' || !readDigits(p, end, 2, second)) return false;
+      if (p != end) {
+        if (*p++ != '.') return false;
+        int digits = 0;
+        while (p != end && digits < kArchiveMaxDecimals && *p >= '0' && *p <= '9') {
+          fraction = fraction * 10 + (*p++ - '0');
+          digits++;
+        }
+        if (digits == 0 || p != end) return false;
+        for (; digits < kArchiveMaxDecimals; digits++) fraction *= 10;
+      }
+    }
+  }
+  if (year < 1 || month < 1 || month > 12 || day < 1 || day > monthDays[month - 1]) return false;
+  bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+  if (month == 2 && day == 29 && !leap) return false;
+  if (hour > 23 || minute > 59 || second > 59) return false;
+
+  micros = daysFromCivil(year, month, day) * kMicrosPerDay +
+           ((hour * 60LL + minute) * 60 + second) * 1000000LL + fraction;
+  return true;
+}
+
+// Inverse of parseTimestamp, in datetime.isoformat() form
+std::string formatTimestamp(long long micros) {
+  long long days = micros / kMicrosPerDay;
+  long long rest = micros % kMicrosPerDay;
+  if (rest < 0) {
+    rest += kMicrosPerDay;
+    days--;
+  }
+  int year, month, day;
+  civilFromDays(days, year, month, day);
+  long long seconds = rest / 1000000;
+  int fraction = static_cast<int>(rest % 1000000);
+
+  char buffer[40];
+  int length = std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d", year, month, day,
+                             static_cast<int>(seconds / 3600), static_cast<int>(seconds / 60 % 60),
+                             static_cast<int>(seconds % 60));
+  if (fraction) std::snprintf(buffer + length, sizeof(buffer) - length, ".%06d", fraction);
+  return buffer;
+}
+
+bool isMissing(const std::string& cell) {
+  return cell.empty() || cell == "NC";
+}
+
+// Plain decimal ("-12.25") as digits and decimal places; false for anything else
+bool parseFixed(const std::string& cell, long long& mantissa, int& decimals, int& intDigits) {
+  const char* p = cell.c_str();
+  const char* end = p + cell.size();
+  bool negative = p != end && *p == '-';
+  if (negative) p++;
+
+  mantissa = 0;
+  decimals = 0;
+  intDigits = 0;
+  bool point = false;
+  for (; p != end; p++) {
+    if (*p == '.' && !point) {
+      point = true;
+    } else if (*p >= '0' && *p <= '9') {
+      if (intDigits + decimals >= kArchiveMaxDigits) return false;
+      mantissa = mantissa * 10 + (*p - '0');
+      if (point) {
+        decimals++;
+      } else {
+        intDigits++;
+      }
+    } else {
+      return false;
+    }
+  }
+  if (intDigits == 0 || (point && decimals == 0) || decimals > kArchiveMaxDecimals) return false;
+  if (negative) mantissa = -mantissa;
+  return true;
+}
+
+// Inverse of parseFixed for a column's decimals ("-0.05" for -5, 2)
+std::string formatFixed(long long mantissa, int decimals) {
+  std::string digits = std::to_string(mantissa < 0 ? -mantissa : mantissa);
+  if (decimals > 0) {
+    if (static_cast<int>(digits.size()) <= decimals) digits.insert(0, decimals + 1 - digits.size(), '0');
+    digits.insert(digits.size() - decimals, 1, '.');
+  }
+  return mantissa < 0 ? "-" + digits : digits;
+}
+
+long long powerOf10(int exponent) {
+  long long value = 1;
+  while (exponent-- > 0) value *= 10;
+  return value;
+}
+
+// Encode one chunk; rows x width cells, row-major
+void writeChunk(FILE* out, const std::vector<long long>& times, const std::vector<std::string>& cells,
+                size_t width, tm_archive_report& report) {
+  size_t rows = times.size();
+  std::vector<unsigned char> head;
+  putLE(head, rows, 4);
+  putLE(head, *std::min_element(times.begin(), times.end()), 8);
+  putLE(head, *std::max_element(times.begin(), times.end()), 8);
+
+  BitWriter stream;
+  stream.put(times[0], 64);
+  long long lastDelta = 0;
+  for (size_t r = 1; r < rows; r++) {
+    long long delta = times[r] - times[r - 1];
+    putTimeCode(stream, delta - lastDelta);
+    lastDelta = delta;
+  }
+  long timestampBits = stream.bits;
+
+  std::vector<long long> codes(rows);
+  std::vector<int> places(rows);
+  for (size_t c = 0; c < width; c++) {
+    // Numeric if every present cell is a plain decimal that fits once scaled
+    bool numeric = true;
+    int decimals = 0;
+    int intDigits = 0;
+    for (size_t r = 0; r < rows && numeric; r++) {
+      const std::string& cell = cells[r * width + c];
+      if (isMissing(cell)) continue;
+      int cellIntDigits;
+      numeric = parseFixed(cell, codes[r], places[r], cellIntDigits);
+      decimals = std::max(decimals, places[r]);
+      intDigits = std::max(intDigits, cellIntDigits);
+    }
+    numeric = numeric && intDigits + decimals <= kArchiveMaxDigits;
+    for (size_t r = 0; r < rows && numeric; r++) {
+      const std::string& cell = cells[r * width + c];
+      numeric = isMissing(cell) || (places[r] == decimals && formatFixed(codes[r], decimals) == cell);
+    }
+
+    if (numeric) {
+      head.push_back(kColumnNumeric);
+      head.push_back(static_cast<unsigned char>(decimals));
+    } else {
+      head.push_back(kColumnText);
+      head.push_back(0);
+      std::map<std::string, long long> dictionary;
+      std::vector<const std::string*> entries;
+      for (size_t r = 0; r < rows; r++) {
+        const std::string& cell = cells[r * width + c];
+        if (isMissing(cell)) continue;
+        std::map<std::string, long long>::iterator it = dictionary.find(cell);
+        if (it == dictionary.end()) {
+          it = dictionary.insert(std::make_pair(cell, static_cast<long long>(entries.size()))).first;
+          entries.push_back(&it->first);
+        }
+        codes[r] = it->second;
+      }
+      putLE(head, entries.size(), 2);
+      for (size_t i = 0; i < entries.size(); i++) {
+        size_t length = std::min<size_t>(entries[i]->size(), 0xFFFF);
+        putLE(head, length, 2);
+        head.insert(head.end(), entries[i]->begin(), entries[i]->begin() + length);
+      }
+    }
+
+    long long last = 0;
+    for (size_t r = 0; r < rows; r++) {
+      const std::string& cell = cells[r * width + c];
+      if (isMissing(cell)) {
+        stream.put(cell.empty() ? 0x1E : 0x1F, 5);
+        continue;
+      }
+      putValueCode(stream, codes[r] - last);
+      last = codes[r];
+    }
+  }
+  report.timestamp_bits += timestampBits;
+  report.value_bits += stream.bits - timestampBits;
+
+  std::vector<unsigned char> length;
+  putLE(length, head.size() + stream.bytes.size(), 4);
+  std::fwrite(length.data(), 1, length.size(), out);
+  std::fwrite(head.data(), 1, head.size(), out);
+  std::fwrite(stream.bytes.data(), 1, stream.bytes.size(), out);
+  report.chunks++;
+}
+
+// Decode one chunk payload (after its length) into the session, keeping
+// rows in [startMicros, endMicros]; false if it is damaged
+bool readChunk(const unsigned char* p, long size, size_t width, int version, long long startMicros,
+               long long endMicros, tm_session* session) {
+  const unsigned char* end = p + size;
+  if (size < 20) return false;
+  long rows = static_cast<long>(getLE(p, 4));
+  p += 20;
+  if (rows <= 0) return false;
+
+  struct Column {
+    unsigned char kind;
+    double scale;
+    std::vector<double> entries;  // Text dictionary, as the CSV reader would parse it
+  };
+  std::vector<Column> columns(width);
+  for (size_t c = 0; c < width; c++) {
+    if (end - p < 2) return false;
+    columns[c].kind = p[0];
+    columns[c].scale = static_cast<double>(powerOf10(p[1]));
+    p += 2;
+    if (columns[c].kind == kColumnText) {
+      if (end - p < 2) return false;
+      long count = static_cast<long>(getLE(p, 2));
+      p += 2;
+      for (long i = 0; i < count; i++) {
+        if (end - p < 2) return false;
+        long length = static_cast<long>(getLE(p, 2));
+        p += 2;
+        if (end - p < length) return false;
+        double value;
+        if (!parseDouble(reinterpret_cast<const char*>(p), reinterpret_cast<const char*>(p) + length, value)) {
+          value = std::numeric_limits<double>::quiet_NaN();
+        }
+        columns[c].entries.push_back(value);
+        p += length;
+      }
+    } else if (columns[c].kind != kColumnNumeric) {
+      return false;
+    }
+  }
+
+  BitReader reader(p, end - p);
+  std::vector<long long> times(rows);
+  unsigned long long first;
+  if (!reader.get(64, first)) return false;
+  times[0] = static_cast<long long>(first);
+  long long delta = 0;
+  for (long r = 1; r < rows; r++) {
+    long long dod;
+    if (!getTimeCode(reader, dod)) return false;
+    delta += dod;
+    times[r] = times[r - 1] + delta;
+  }
+
+  // Output row of each chunk row, or -1 if outside the range
+  std::vector<long> slot(rows, -1);
+  long kept = 0;
+  for (long r = 0; r < rows; r++) {
+    if (times[r] >= startMicros && times[r] <= endMicros) slot[r] = kept++;
+  }
+  const double missing = std::numeric_limits<double>::quiet_NaN();
+  std::vector<double> values(kept * width, missing);
+
+  for (size_t c = 0; c < width; c++) {
+    const Column& column = columns[c];
+    long long last = 0;
+    for (long r = 0; r < rows; r++) {
+      long long code;
+      int status = getValueCode(reader, version, code);
+      if (status < 0) return false;
+      if (status == 0) continue;
+      last += code;
+      if (slot[r] < 0) continue;
+      double& value = values[slot[r] * width + c];
+      if (column.kind == kColumnNumeric) {
+        value = last / column.scale;
+      } else if (last >= 0 && last < static_cast<long long>(column.entries.size())) {
+        value = column.entries[last];
+      }
+    }
+  }
+
+  for (long r = 0; r < rows; r++) {
+    if (slot[r] >= 0) session->timestamps.push_back(formatTimestamp(times[r]));
+  }
+  session->values.insert(session->values.end(), values.begin(), values.end());
+  return true;
+}
+
+}  // namespace
+
+// Format version of an archive (its magic read), or 0 for a CSV (rewound)
+static int archiveVersion(FILE* f) {
+  char magic[sizeof(kArchiveMagic)];
+  if (std::fread(magic, 1, sizeof(magic), f) == sizeof(magic)) {
+    if (!std::memcmp(magic, kArchiveMagic, sizeof(magic))) return 2;
+    if (!std::memcmp(magic, kArchiveMagicV1, sizeof(magic))) return 1;
+  }
+  std::rewind(f);
+  return 0;
+}
+
+// Reads the rest of an archive after its magic; a damaged or torn chunk ends it
+static void loadArchive(FILE* f, int version, tm_session* session, const char* start, const char* end) {
+  unsigned char fixed[10];
+  if (std::fread(fixed, 1, sizeof(fixed), f) != sizeof(fixed)) return;
+  long width = static_cast<long>(getLE(fixed + 8, 2));
+  std::vector<std::string> columns;
+  for (long c = 0; c < width; c++) {
+    unsigned char length[2];
+    if (std::fread(length, 1, 2, f) != 2) return;
+    std::string name(getLE(length, 2), '\0');
+    if (!name.empty() && std::fread(&name[0], 1, name.size(), f) != name.size()) return;
+    columns.push_back(name);
+  }
+  session->columns = columns;
+
+  long long startMicros = std::numeric_limits<long long>::min();
+  long long endMicros = std::numeric_limits<long long>::max();
+  if (start && !parseTimestamp(start, start + std::strlen(start), startMicros)) {
+    startMicros = std::numeric_limits<long long>::min();
+  }
+  if (end && !parseTimestamp(end, end + std::strlen(end), endMicros)) {
+    endMicros = std::numeric_limits<long long>::max();
+  }
+
+  std::vector<unsigned char> payload;
+  unsigned char head[24];
+  while (std::fread(head, 1, sizeof(head), f) == sizeof(head)) {
+    long size = static_cast<long>(getLE(head, 4));
+    long long minMicros = static_cast<long long>(getLE(head + 8, 8));
+    long long maxMicros = static_cast<long long>(getLE(head + 16, 8));
+    if (size < 20) break;
+    if (maxMicros < startMicros || minMicros > endMicros) {
+      if (std::fseek(f, size - 20, SEEK_CUR) != 0) break;
+      continue;
+    }
+    payload.assign(head + 4, head + sizeof(head));
+    payload.resize(size);
+    if (std::fread(payload.data() + 20, 1, size - 20, f) != static_cast<size_t>(size - 20)) break;
+    if (!readChunk(payload.data(), size, width, version, startMicros, endMicros, session)) break;
+  }
+}
+
+extern "C" int tm_archive_write(const char* csv_path, const char* out_path, long chunk_rows,
+                                tm_archive_report* report) {
+  if (!csv_path || !out_path || chunk_rows <= 0) return -1;
+  chunk_rows = std::min(chunk_rows, kArchiveMaxChunkRows);
+  tm_archive_report totals = {};
+
+  FILE* in = std::fopen(csv_path, "rb");
+  if (!in) return -1;
+  std::fseek(in, 0, SEEK_END);
+  totals.source_bytes = std::ftell(in);
+  std::rewind(in);
+
+  std::string line;
+  std::vector<std::string> fields;
+  if (!readLine(in, line)) {
+    std::fclose(in);
+    return -1;
+  }
+  splitCommas(line, fields);
+  size_t width = fields.size() - 1;
+  totals.columns = static_cast<long>(width);
+
+  FILE* out = std::fopen(out_path, "wb");
+  if (!out) {
+    std::fclose(in);
+    return -1;
+  }
+  std::vector<unsigned char> header(kArchiveMagic, kArchiveMagic + sizeof(kArchiveMagic));
+  putLE(header, totals.source_bytes, 8);
+  putLE(header, width, 2);
+  for (size_t c = 0; c < width; c++) {
+    size_t length = std::min<size_t>(fields[c + 1].size(), 0xFFFF);
+    putLE(header, length, 2);
+    header.insert(header.end(), fields[c + 1].begin(), fields[c + 1].begin() + length);
+  }
+  std::fwrite(header.data(), 1, header.size(), out);
+
+  std::vector<long long> times;
+  std::vector<std::string> cells;
+  while (readLine(in, line)) {
+    splitCommas(line, fields);
+    if (fields.size() <= 1) continue;
+    long long micros;
+    if (!parseTimestamp(fields[0].data(), fields[0].data() + fields[0].size(), micros)) {
+      totals.skipped++;
+      continue;
+    }
+    times.push_back(micros);
+    for (size_t c = 0; c < width; c++) {
+      cells.push_back(c + 1 < fields.size() ? fields[c + 1] : std::string());
+    }
+    totals.rows++;
+    if (static_cast<long>(times.size()) == chunk_rows) {
+      writeChunk(out, times, cells, width, totals);
+      times.clear();
+      cells.clear();
+    }
+  }
+  if (!times.empty()) writeChunk(out, times, cells, width, totals);
+  std::fclose(in);
+
+  totals.archive_bytes = std::ftell(out);
+  bool failed = std::ferror(out) != 0;
+  failed = std::fclose(out) != 0 || failed;
+  if (failed) return -1;
+  if (report) *report = totals;
+  return 0;
+}
+
+// ============================================================================
+// DOWNSAMPLER (LARGEST-TRIANGLE-THREE-BUCKETS)
+// ============================================================================
+
+static double scoreValue(double v) {
+  return std::isnan(v) ? 0.0 : v;
+}
+
+extern "C" long tm_downsample_lttb(const double* y, long n, long threshold, long* out_idx) {
+  if (!y || !out_idx || n <= 0 || threshold <= 0) return 0;
+
+  if (threshold >= n || threshold < 3) {
+    long count = threshold < n ? threshold : n;
+    for (long i = 0; i < count; i++) out_idx[i] = i;
+    return count;
+  }
+
+  long count = 0;
+  double bucketSize = static_cast<double>(n - 2) / (threshold - 2);
+  long a = 0;
+  out_idx[count++] = 0;
+
+  for (long bucket = 0; bucket < threshold - 2; bucket++) {
+    // Average point of the next bucket
+    long nextBegin = static_cast<long>((bucket + 1) * bucketSize) + 1;
+    long nextEnd = static_cast<long>((bucket + 2) * bucketSize) + 1;
+    if (nextEnd > n) nextEnd = n;
+    double avgX = 0.0;
+    double avgY = 0.0;
+    for (long i = nextBegin; i < nextEnd; i++) {
+      avgX += i;
+      avgY += scoreValue(y[i]);
+    }
+    long nextCount = nextEnd - nextBegin;
+    if (nextCount > 0) {
+      avgX /= nextCount;
+      avgY /= nextCount;
+    }
+
+    // Point in this bucket forming the largest triangle with a and the average
+    long begin = static_cast<long>(bucket * bucketSize) + 1;
+    long end = static_cast<long>((bucket + 1) * bucketSize) + 1;
+    double ay = scoreValue(y[a]);
+    double maxArea = -1.0;
+    long chosen = begin;
+    for (long i = begin; i < end; i++) {
+      double area = std::fabs((a - avgX) * (scoreValue(y[i]) - ay) - (a - i) * (avgY - ay));
+      if (area > maxArea) {
+        maxArea = area;
+        chosen = i;
+      }
+    }
+    out_idx[count++] = chosen;
+    a = chosen;
+  }
+
+  out_idx[count++] = n - 1;
+  return count;
+}
+
+// ============================================================================
+// ROLLING STATISTICS
+// ============================================================================
+//
+// Each probe keeps one ring of its last `capacity` samples. Every window is a
+// suffix of that ring: its own oldest sequence number, Welford mean/variance
+// of the values, co-moment of (time, value) for the slope, and monotonic
+// queues of sequence numbers for min/max. Adding a sample pushes it into each
+// window, then retires the samples that fell out of the window (or off the
+// ring); each sample enters and leaves every window once, so the work is
+// amortized O(1) and reading the results is O(1).
+//
+// Memory grows with use: the ring doubles up to `capacity` (16 bytes per
+// sample) and each queue doubles up to the samples its window holds. A queue
+// only holds a monotonic run of its window, so it stays small for real
+// readings; its worst case (a steady ramp) is 8 bytes per sample in the window.
+
+namespace {
+
+// Growable ring queue of sequence numbers (front = oldest)
+struct SeqQueue {
+  std::vector<long long> slots;
+  long head = 0;
+  long size = 0;
+
+  // Make room for one more (limit: the most the queue can ever hold)
+  void reserve(long limit) {
+    if (size < static_cast<long>(slots.size())) return;
+    std::vector<long long> grown(std::min(limit, std::max(16L, size * 2)));
+    for (long i = 0; i < size; i++) grown[i] = slots[(head + i) % slots.size()];
+    slots.swap(grown);
+    head = 0;
+  }
+
+  long long front() const { return slots[head]; }
+  long long back() const { return slots[(head + size - 1) % slots.size()]; }
+  void popFront() { head = (head + 1) % slots.size(); size--; }
+  void popBack() { size--; }
+  void pushBack(long long seq) { slots[(head + size) % slots.size()] = seq; size++; }
+};
+
+struct Window {
+  double seconds = 0.0;
+  long long oldest = 0;  // Sequence number of the oldest sample in the window
+  long count = 0;
+  double meanT = 0.0;    // Times are relative to the probe's first sample
+  double meanV = 0.0;
+  double m2T = 0.0;
+  double m2V = 0.0;
+  double coTV = 0.0;
+  SeqQueue minQueue;     // Increasing values
+  SeqQueue maxQueue;     // Decreasing values
+};
+
+struct ProbeStats {
+  std::vector<double> times;
+  std::vector<double> values;
+  long long next = 0;    // Sequence number of the next sample
+  long count = 0;
+  double epoch = 0.0;
+  double last = 0.0;
+  double lastTime = 0.0;
+  double ewma = 0.0;
+  std::vector<Window> windows;
+};
+
+}  // namespace
+
+struct tm_stats {
+  long capacity;
+  double ewmaTau;
+  std::vector<double> windowSeconds;
+  std::vector<ProbeStats> probes;
+};
+
+static double sampleTime(const ProbeStats& p, long long seq) {
+  return p.times[seq % p.times.size()];
+}
+
+static double sampleValue(const ProbeStats& p, long long seq) {
+  return p.values[seq % p.values.size()];
+}
+
+static void windowAdd(ProbeStats& p, Window& w, long long seq) {
+  long limit = static_cast<long>(p.times.size());
+  double t = sampleTime(p, seq);
+  double v = sampleValue(p, seq);
+  w.count++;
+  double dT = t - w.meanT;
+  double dV = v - w.meanV;
+  w.meanT += dT / w.count;
+  w.meanV += dV / w.count;
+  w.m2T += dT * (t - w.meanT);
+  w.m2V += dV * (v - w.meanV);
+  w.coTV += dT * (v - w.meanV);
+
+  while (w.minQueue.size && sampleValue(p, w.minQueue.back()) >= v) w.minQueue.popBack();
+  w.minQueue.reserve(limit);
+  w.minQueue.pushBack(seq);
+  while (w.maxQueue.size && sampleValue(p, w.maxQueue.back()) <= v) w.maxQueue.popBack();
+  w.maxQueue.reserve(limit);
+  w.maxQueue.pushBack(seq);
+}
+
+// Retire the window's oldest sample (the inverse of windowAdd)
+static void windowRemoveOldest(ProbeStats& p, Window& w) {
+  long long seq = w.oldest++;
+  if (w.minQueue.size && w.minQueue.front() == seq) w.minQueue.popFront();
+  if (w.maxQueue.size && w.maxQueue.front() == seq) w.maxQueue.popFront();
+
+  if (--w.count == 0) {
+    w.meanT = w.meanV = w.m2T = w.m2V = w.coTV = 0.0;
+    return;
+  }
+  double t = sampleTime(p, seq);
+  double v = sampleValue(p, seq);
+  double oldMeanV = w.meanV;
+  double dT = t - w.meanT;
+  w.meanT -= dT / w.count;
+  w.meanV -= (v - w.meanV) / w.count;
+  w.m2T -= (t - w.meanT) * dT;
+  w.m2V -= (v - w.meanV) * (v - oldMeanV);
+  w.coTV -= (t - w.meanT) * (v - oldMeanV);
+  if (w.m2T < 0.0) w.m2T = 0.0;
+  if (w.m2V < 0.0) w.m2V = 0.0;
+}
+
+static void resetProbe(tm_stats* stats, ProbeStats& p) {
+  p = ProbeStats();
+  p.windows.resize(stats->windowSeconds.size());
+  for (size_t i = 0; i < p.windows.size(); i++) p.windows[i].seconds = stats->windowSeconds[i];
+}
+
+extern "C" tm_stats* tm_stats_create(int probes, long capacity, const double* windows, int window_count, double ewma_tau) {
+  if (probes <= 0 || capacity <= 0 || !windows || window_count <= 0 || window_count > TM_STATS_MAX_WINDOWS) {
+    return nullptr;
+  }
+  tm_stats* stats = new tm_stats();
+  stats->capacity = capacity;
+  stats->ewmaTau = ewma_tau;
+  stats->windowSeconds.assign(windows, windows + window_count);
+  stats->probes.resize(probes);
+  for (ProbeStats& p : stats->probes) resetProbe(stats, p);
+  return stats;
+}
+
+extern "C" void tm_stats_destroy(tm_stats* stats) {
+  delete stats;
+}
+
+extern "C" void tm_stats_add(tm_stats* stats, int probe, double time, double value) {
+  if (!stats || probe < 0 || probe >= static_cast<int>(stats->probes.size()) || std::isnan(value)) return;
+  ProbeStats& p = stats->probes[probe];
+
+  // The ring doubles until it holds `capacity` samples. It only wraps once it
+  // is that size, so growing never moves a sample (slot = seq % size).
+  long size = static_cast<long>(p.times.size());
+  if (p.next == size && size < stats->capacity) {
+    size = std::min(stats->capacity, std::max(64L, size * 2));
+    p.times.resize(size);
+    p.values.resize(size);
+  }
+
+  if (p.count == 0) {
+    p.epoch = time;
+    p.ewma = value;
+  } else {
+    if (time < p.lastTime) time = p.lastTime;
+    double weight = stats->ewmaTau > 0.0 ? 1.0 - std::exp(-(time - p.lastTime) / stats->ewmaTau) : 1.0;
+    p.ewma += weight * (value - p.ewma);
+  }
+  p.count++;
+  p.last = value;
+  p.lastTime = time;
+
+  // The ring is full: its oldest sample leaves every window still holding it
+  long long overwritten = p.next - stats->capacity;
+  if (overwritten >= 0) {
+    for (Window& w : p.windows) {
+      if (w.count && w.oldest == overwritten) windowRemoveOldest(p, w);
+    }
+  }
+
+  long long seq = p.next++;
+  p.times[seq % size] = time - p.epoch;
+  p.values[seq % size] = value;
+
+  double cutoff = time - p.epoch;
+  for (Window& w : p.windows) {
+    if (w.count == 0) w.oldest = seq;
+    windowAdd(p, w, seq);
+    while (w.count > 1 && sampleTime(p, w.oldest) < cutoff - w.seconds) windowRemoveOldest(p, w);
+  }
+}
+
+extern "C" void tm_stats_reset(tm_stats* stats, int probe) {
+  if (!stats || probe < 0 || probe >= static_cast<int>(stats->probes.size())) return;
+  resetProbe(stats, stats->probes[probe]);
+}
+
+extern "C" int tm_stats_get(const tm_stats* stats, int probe, tm_probe_stats* out) {
+  if (!stats || !out || probe < 0 || probe >= static_cast<int>(stats->probes.size())) return -1;
+  const ProbeStats& p = stats->probes[probe];
+
+  out->count = p.count;
+  out->last = p.last;
+  out->last_time = p.lastTime;
+  out->ewma = p.ewma;
+  out->windows = static_cast<int>(p.windows.size());
+  for (size_t i = 0; i < p.windows.size(); i++) {
+    const Window& w = p.windows[i];
+    tm_window_stats& o = out->window[i];
+    o.seconds = w.seconds;
+    o.count = w.count;
+    if (w.count == 0) {
+      o.span = o.mean = o.stddev = o.slope = o.min = o.max = 0.0;
+      continue;
+    }
+    o.span = p.lastTime - p.epoch - sampleTime(p, w.oldest);
+    o.mean = w.meanV;
+    o.stddev = w.count > 1 ? std::sqrt(w.m2V / (w.count - 1)) : 0.0;
+    o.slope = (w.count > 1 && w.m2T > 0.0) ? w.coTV / w.m2T : 0.0;
+    o.min = sampleValue(p, w.minQueue.front());
+    o.max = sampleValue(p, w.maxQueue.front());
+  }
+  return 0;
+}
+
+// ============================================================================
+// STREAMING ALERT RULES
+// ============================================================================
+//
+// Rules are compiled into one flat array of rule indices grouped by probe
+// (probeRules[probeBegin[p] .. probeBegin[p + 1])); a DEVIATION rule is
+// listed under both of its probes. A reading updates its probe's state and
+// walks only that list, so ingest cost does not grow with the total rule
+// count. STALE rules are also kept in their own list for the periodic tick.
+
+namespace {
+
+struct AlertProbe {
+  bool seen = false;
+  double lastTime = 0.0;
+  double value = 0.0;
+  double level = 0.0;  // EWMA of the value, differentiated for SLOPE rules
+  double slope = 0.0;  // °C/s
+};
+
+}  // namespace
+
+struct tm_alerts {
+  std::vector<tm_alert_rule> rules;
+  std::vector<char> active;
+  std::vector<int> probeBegin;
+  std::vector<int> probeRules;
+  std::vector<int> staleRules;
+  std::vector<AlertProbe> probes;
+  double slopeTau = 0.0;
+  double firstTick = -1.0;  // Unseen probes are stale counted from here
+  std::vector<tm_alert_event> queue;
+  size_t queueHead = 0;
+  size_t queueSize = 0;
+  long dropped = 0;
+};
+
+static void pushAlertEvent(tm_alerts* alerts, int rule, bool raised, double time, double value) {
+  alerts->active[rule] = raised;
+  if (alerts->queueSize == alerts->queue.size()) {
+    alerts->queueHead = (alerts->queueHead + 1) % alerts->queue.size();
+    alerts->queueSize--;
+    alerts->dropped++;
+  }
+  tm_alert_event& event = alerts->queue[(alerts->queueHead + alerts->queueSize) % alerts->queue.size()];
+  event.rule = rule;
+  event.raised = raised ? 1 : 0;
+  event.time = time;
+  event.value = value;
+  alerts->queueSize++;
+}
+
+// Raise when measure > limit, clear once it is back under limit - hysteresis
+static void evaluateAlert(tm_alerts* alerts, int rule, double measure, double time) {
+  const tm_alert_rule& r = alerts->rules[rule];
+  if (!alerts->active[rule]) {
+    if (measure > r.limit) pushAlertEvent(alerts, rule, true, time, measure);
+  } else if (measure < r.limit - r.hysteresis) {
+    pushAlertEvent(alerts, rule, false, time, measure);
+  }
+}
+
+extern "C" tm_alerts* tm_alerts_create(const tm_alert_rule* rules, int count, int probes, double slope_tau, int queue_size) {
+  if (count < 0 || (count > 0 && !rules) || probes < 0 || queue_size <= 0) return nullptr;
+  for (int i = 0; i < count; i++) {
+    const tm_alert_rule& r = rules[i];
+    if (r.kind < TM_ALERT_ABOVE || r.kind > TM_ALERT_STALE || r.probe < 0 || r.probe >= probes) return nullptr;
+    if (r.kind == TM_ALERT_DEVIATION && (r.other < 0 || r.other >= probes || r.other == r.probe)) return nullptr;
+  }
+
+  tm_alerts* alerts = new tm_alerts();
+  alerts->rules.assign(rules, rules + count);
+  alerts->active.assign(count, 0);
+  alerts->probes.resize(probes);
+  alerts->slopeTau = slope_tau;
+  alerts->queue.resize(queue_size);
+
+  // Counting sort of rule indices by probe
+  alerts->probeBegin.assign(probes + 1, 0);
+  for (const tm_alert_rule& r : alerts->rules) {
+    alerts->probeBegin[r.probe + 1]++;
+    if (r.kind == TM_ALERT_DEVIATION) alerts->probeBegin[r.other + 1]++;
+  }
+  for (int p = 0; p < probes; p++) alerts->probeBegin[p + 1] += alerts->probeBegin[p];
+  alerts->probeRules.resize(alerts->probeBegin[probes]);
+  std::vector<int> fill(alerts->probeBegin.begin(), alerts->probeBegin.end() - 1);
+  for (int i = 0; i < count; i++) {
+    const tm_alert_rule& r = alerts->rules[i];
+    alerts->probeRules[fill[r.probe]++] = i;
+    if (r.kind == TM_ALERT_DEVIATION) alerts->probeRules[fill[r.other]++] = i;
+    if (r.kind == TM_ALERT_STALE) alerts->staleRules.push_back(i);
+  }
+  return alerts;
+}
+
+extern "C" void tm_alerts_destroy(tm_alerts* alerts) {
+  delete alerts;
+}
+
+extern "C" int tm_alerts_ingest(tm_alerts* alerts, int probe, double time, double value) {
+  if (!alerts || probe < 0 || probe >= static_cast<int>(alerts->probes.size()) || std::isnan(value)) {
+    return alerts ? static_cast<int>(alerts->queueSize) : 0;
+  }
+  AlertProbe& p = alerts->probes[probe];
+  if (!p.seen) {
+    p.seen = true;
+    p.level = value;
+    p.lastTime = time;
+  } else if (time > p.lastTime) {
+    double dt = time - p.lastTime;
+    double weight = alerts->slopeTau > 0.0 ? 1.0 - std::exp(-dt / alerts->slopeTau) : 1.0;
+    double level = p.level + weight * (value - p.level);
+    p.slope += weight * ((level - p.level) / dt - p.slope);
+    p.level = level;
+    p.lastTime = time;
+  }
+  p.value = value;
+
+  for (int k = alerts->probeBegin[probe]; k < alerts->probeBegin[probe + 1]; k++) {
+    int rule = alerts->probeRules[k];
+    const tm_alert_rule& r = alerts->rules[rule];
+    switch (r.kind) {
+      case TM_ALERT_ABOVE:
+        evaluateAlert(alerts, rule, value, time);
+        break;
+      case TM_ALERT_BELOW:
+        // Raise under limit, clear once back over limit + hysteresis
+        if (!alerts->active[rule]) {
+          if (value < r.limit) pushAlertEvent(alerts, rule, true, time, value);
+        } else if (value > r.limit + r.hysteresis) {
+          pushAlertEvent(alerts, rule, false, time, value);
+        }
+        break;
+      case TM_ALERT_SLOPE:
+        evaluateAlert(alerts, rule, std::fabs(p.slope), time);
+        break;
+      case TM_ALERT_DEVIATION: {
+        const AlertProbe& a = alerts->probes[r.probe];
+        const AlertProbe& b = alerts->probes[r.other];
+        if (a.seen && b.seen) evaluateAlert(alerts, rule, std::fabs(a.value - b.value), time);
+        break;
+      }
+      case TM_ALERT_STALE:
+        // A reading ends staleness; raising is left to tm_alerts_tick
+        if (alerts->active[rule]) pushAlertEvent(alerts, rule, false, time, 0.0);
+        break;
+    }
+  }
+  return static_cast<int>(alerts->queueSize);
+}
+
+extern "C" int tm_alerts_tick(tm_alerts* alerts, double now) {
+  if (!alerts) return 0;
+  if (alerts->firstTick < 0.0) alerts->firstTick = now;
+  for (int rule : alerts->staleRules) {
+    const tm_alert_rule& r = alerts->rules[rule];
+    const AlertProbe& p = alerts->probes[r.probe];
+    double age = now - (p.seen ? p.lastTime : alerts->firstTick);
+    if (!alerts->active[rule] && age > r.limit) pushAlertEvent(alerts, rule, true, now, age);
+  }
+  return static_cast<int>(alerts->queueSize);
+}
+
+extern "C" int tm_alerts_poll(tm_alerts* alerts, tm_alert_event* out, int max_out) {
+  if (!alerts || !out) return 0;
+  int count = 0;
+  while (count < max_out && alerts->queueSize > 0) {
+    out[count++] = alerts->queue[alerts->queueHead];
+    alerts->queueHead = (alerts->queueHead + 1) % alerts->queue.size();
+    alerts->queueSize--;
+  }
+  return count;
+}
+
+extern "C" long tm_alerts_dropped(const tm_alerts* alerts) {
+  return alerts ? alerts->dropped : 0;
+}
+
+// ============================================================================
+// TIMER WHEEL
+// ============================================================================
+//
+// Timers sit in intrusive doubly-linked bucket lists (next/prev arrays), so
+// arming, re-arming and cancelling never search. A timer goes in the lowest
+// level whose span covers its distance from the current tick; when level 0
+// wraps, the due bucket of the next level is cascaded down one level.
+
+namespace {
+
+const int kWheelBits0 = 8;  // 256 level-0 buckets
+const int kWheelBitsN = 6;  // 64 buckets in each higher level
+const int kWheelLevels = 4;
+const long long kWheelSpan = 1LL << (kWheelBits0 + kWheelBitsN * (kWheelLevels - 1));
+
+int wheelShift(int level) {
+  return level == 0 ? 0 : kWheelBits0 + kWheelBitsN * (level - 1);
+}
+
+int wheelBase(int level) {
+  return level == 0 ? 0 : (1 << kWheelBits0) + (level - 1) * (1 << kWheelBitsN);
+}
+
+int wheelMask(int level) {
+  return (1 << (level == 0 ? kWheelBits0 : kWheelBitsN)) - 1;
+}
+
+}  // namespace
+
+struct tm_wheel {
+  double tick;
+  long long current;            // Last tick processed
+  std::vector<long long> deadline;
+  std::vector<int> bucket;      // -1 = not armed
+  std::vector<int> next;
+  std::vector<int> prev;
+  std::vector<int> heads;       // First timer per bucket, -1 = empty
+  std::vector<int> due;         // Fired, not yet returned
+  size_t dueHead = 0;
+};
+
+static void wheelUnlink(tm_wheel* wheel, int timer) {
+  int b = wheel->bucket[timer];
+  if (b < 0) return;
+  if (wheel->prev[timer] >= 0) {
+    wheel->next[wheel->prev[timer]] = wheel->next[timer];
+  } else {
+    wheel->heads[b] = wheel->next[timer];
+  }
+  if (wheel->next[timer] >= 0) wheel->prev[wheel->next[timer]] = wheel->prev[timer];
+  wheel->bucket[timer] = -1;
+}
+
+static void wheelInsert(tm_wheel* wheel, int timer) {
+  long long when = wheel->deadline[timer];
+  long long delta = when - wheel->current;
+  if (delta <= 0) {
+    wheel->due.push_back(timer);
+    return;
+  }
+  if (delta >= kWheelSpan) when = wheel->current + kWheelSpan - 1;
+  delta = when - wheel->current;
+
+  int level = 0;
+  while (level < kWheelLevels - 1 && delta >= (1LL << wheelShift(level + 1))) level++;
+  int b = wheelBase(level) + static_cast<int>((when >> wheelShift(level)) & wheelMask(level));
+
+  wheel->bucket[timer] = b;
+  wheel->prev[timer] = -1;
+  wheel->next[timer] = wheel->heads[b];
+  if (wheel->heads[b] >= 0) wheel->prev[wheel->heads[b]] = timer;
+  wheel->heads[b] = timer;
+}
+
+// Re-insert every timer of one bucket relative to the current tick
+static void wheelCascade(tm_wheel* wheel, int b) {
+  int timer = wheel->heads[b];
+  wheel->heads[b] = -1;
+  while (timer >= 0) {
+    int following = wheel->next[timer];
+    wheel->bucket[timer] = -1;
+    wheelInsert(wheel, timer);
+    timer = following;
+  }
+}
+
+extern "C" tm_wheel* tm_wheel_create(int timers, double tick_seconds, double start) {
+  if (timers <= 0 || !(tick_seconds > 0.0)) return nullptr;
+  tm_wheel* wheel = new tm_wheel();
+  wheel->tick = tick_seconds;
+  wheel->current = static_cast<long long>(std::floor(start / tick_seconds));
+  wheel->deadline.assign(timers, 0);
+  wheel->bucket.assign(timers, -1);
+  wheel->next.assign(timers, -1);
+  wheel->prev.assign(timers, -1);
+  wheel->heads.assign(wheelBase(kWheelLevels), -1);
+  return wheel;
+}
+
+extern "C" void tm_wheel_destroy(tm_wheel* wheel) {
+  delete wheel;
+}
+
+extern "C" void tm_wheel_schedule(tm_wheel* wheel, int timer, double deadline) {
+  if (!wheel || timer < 0 || timer >= static_cast<int>(wheel->bucket.size())) return;
+  wheelUnlink(wheel, timer);
+  wheel->deadline[timer] = static_cast<long long>(std::ceil(deadline / wheel->tick));
+  wheelInsert(wheel, timer);
+}
+
+extern "C" void tm_wheel_cancel(tm_wheel* wheel, int timer) {
+  if (!wheel || timer < 0 || timer >= static_cast<int>(wheel->bucket.size())) return;
+  wheelUnlink(wheel, timer);
+  // A fired timer not yet returned is dropped too
+  for (size_t i = wheel->dueHead; i < wheel->due.size(); i++) {
+    if (wheel->due[i] == timer) wheel->due[i] = -1;
+  }
+}
+
+extern "C" int tm_wheel_advance(tm_wheel* wheel, double now, int* out, int max_out) {
+  if (!wheel || !out) return 0;
+  long long target = static_cast<long long>(std::floor(now / wheel->tick));
+  if (target - wheel->current > wheelMask(0)) {
+    // A gap of a whole level-0 turn or more (a stall, a suspend): re-filing
+    // every armed timer at the new tick costs O(timers), stepping O(ticks)
+    std::vector<int> armed;
+    for (int timer = 0; timer < static_cast<int>(wheel->bucket.size()); timer++) {
+      if (wheel->bucket[timer] >= 0) {
+        wheelUnlink(wheel, timer);
+        armed.push_back(timer);
+      }
+    }
+    std::stable_sort(armed.begin(), armed.end(),
+                     [wheel](int a, int b) { return wheel->deadline[a] < wheel->deadline[b]; });
+    wheel->current = target;
+    for (int timer : armed) wheelInsert(wheel, timer);
+  }
+  while (wheel->current < target) {
+    long long tick = ++wheel->current;
+    if ((tick & wheelMask(0)) == 0) {
+      // Level 0 wrapped: pull the next bucket of each higher level down,
+      // highest first so its timers can land in the lower buckets
+      int top = 1;
+      while (top < kWheelLevels - 1 && ((tick >> wheelShift(top)) & wheelMask(top)) == 0) top++;
+      for (int level = top; level >= 1; level--) {
+        wheelCascade(wheel, wheelBase(level) + static_cast<int>((tick >> wheelShift(level)) & wheelMask(level)));
+      }
+    }
+    wheelCascade(wheel, static_cast<int>(tick & wheelMask(0)));
+  }
+
+  int count = 0;
+  while (count < max_out && wheel->dueHead < wheel->due.size()) {
+    int timer = wheel->due[wheel->dueHead++];
+    if (timer >= 0) out[count++] = timer;
+  }
+  if (wheel->dueHead == wheel->due.size()) {
+    wheel->due.clear();
+    wheel->dueHead = 0;
+  }
+  return count;
+}
+
+// ============================================================================
+// PID HEATER LOOP
+// ============================================================================
+//
+// One thread per loop, waking on absolute deadlines (start + k * period) so
+// lateness never accumulates; a wake-up more than a period late skips the
+// missed ticks and counts them as overruns. Each tick samples the latest
+// probe value, runs the PID and time-proportions the on/off heater over
+// `window`. All shared state sits behind one mutex held only briefly.
+
+namespace {
+
+typedef std::chrono::steady_clock PidClock;
+
+double secondsBetween(PidClock::time_point a, PidClock::time_point b) {
+  return std::chrono::duration<double>(b - a).count();
+}
+
+bool validPidConfig(const tm_pid_config& c) {
+  return c.period > 0.0 && c.window >= c.period && c.out_max > c.out_min &&
+         c.derivative_tau >= 0.0 && c.feedback_timeout > 0.0;
+}
+
+}  // namespace
+
+struct tm_pid {
+  std::mutex lock;
+  std::condition_variable wake;
+  std::thread thread;
+  bool stopping = false;
+  tm_pid_config config;
+  std::string heaterPath;
+  int heaterWritten = -1;  // Last value written to heaterPath
+
+  bool haveFeedback = false;
+  double feedback = 0.0;
+  PidClock::time_point feedbackAt;
+  double previous = 0.0;   // Feedback at the last tick, for the D term
+  bool havePrevious = false;
+
+  tm_pid_status status;
+  double jitterM2 = 0.0;
+};
+
+static void writeHeater(tm_pid* pid, int on) {
+  if (pid->heaterPath.empty() || on == pid->heaterWritten) return;
+  FILE* f = std::fopen(pid->heaterPath.c_str(), "w");
+  if (!f) return;  // Retried on the next change
+  std::fputs(on ? "1" : "0", f);
+  if (std::fclose(f) == 0) pid->heaterWritten = on;
+}
+
+// One tick (caller holds pid->lock)
+static void pidTick(tm_pid* pid, PidClock::time_point now, double sinceStart) {
+  const tm_pid_config& c = pid->config;
+  tm_pid_status& s = pid->status;
+  double dt = c.period;
+
+  s.feedback_age = pid->haveFeedback ? secondsBetween(pid->feedbackAt, now) : 0.0;
+  s.feedback_ok = pid->haveFeedback && s.feedback_age <= c.feedback_timeout;
+  if (!s.feedback_ok) {
+    // Fail safe: heater off, nothing integrated while blind
+    s.p = s.i = s.d = 0.0;
+    s.output = c.out_min;
+    s.heater_on = 0;
+    pid->havePrevious = false;
+    writeHeater(pid, 0);
+    return;
+  }
+
+  double y = pid->feedback;
+  double error = c.setpoint - y;
+  s.feedback = y;
+  s.p = c.kp * error;
+
+  // Derivative on the measurement (no kick on setpoint changes), low-passed
+  double rawD = pid->havePrevious ? -c.kd * (y - pid->previous) / dt : 0.0;
+  s.d += (dt / (c.derivative_tau + dt)) * (rawD - s.d);
+  pid->previous = y;
+  pid->havePrevious = true;
+
+  // Anti-windup: integrate only while that does not push a saturated output further
+  double integral = s.i + c.ki * error * dt;
+  double unclamped = s.p + integral + s.d;
+  bool windingUp = (unclamped > c.out_max && error > 0.0) || (unclamped < c.out_min && error < 0.0);
+  if (!windingUp) s.i = std::max(c.out_min, std::min(c.out_max, integral));
+
+  s.output = std::max(c.out_min, std::min(c.out_max, s.p + s.i + s.d));
+  double duty = (s.output - c.out_min) / (c.out_max - c.out_min);
+  double phase = std::fmod(sinceStart, c.window);
+  s.heater_on = phase < duty * c.window;
+  writeHeater(pid, s.heater_on);
+}
+
+static void pidRun(tm_pid* pid) {
+  std::unique_lock<std::mutex> guard(pid->lock);
+  PidClock::time_point start = PidClock::now();
+  PidClock::time_point deadline = start;
+  while (!pid->stopping) {
+    std::chrono::duration<double> period(pid->config.period);
+    deadline += std::chrono::duration_cast<PidClock::duration>(period);
+    pid->wake.wait_until(guard, deadline, [pid] { return pid->stopping; });
+    if (pid->stopping) break;
+
+    PidClock::time_point now = PidClock::now();
+    double late = secondsBetween(deadline, now);
+    if (late > pid->config.period) {
+      long missed = static_cast<long>(late / pid->config.period);
+      pid->status.overruns += missed;
+      deadline += std::chrono::duration_cast<PidClock::duration>(period * static_cast<double>(missed));
+      late = secondsBetween(deadline, now);
+    }
+
+    tm_pid_status& s = pid->status;
+    double lateUs = late * 1e6;
+    s.ticks++;
+    double delta = lateUs - s.jitter_mean_us;
+    s.jitter_mean_us += delta / s.ticks;
+    pid->jitterM2 += delta * (lateUs - s.jitter_mean_us);
+    s.jitter_stddev_us = s.ticks > 1 ? std::sqrt(pid->jitterM2 / (s.ticks - 1)) : 0.0;
+    s.jitter_last_us = lateUs;
+    if (lateUs > s.jitter_max_us) s.jitter_max_us = lateUs;
+
+    pidTick(pid, now, secondsBetween(start, deadline));
+  }
+  pid->heaterWritten = -1;
+  writeHeater(pid, 0);
+}
+
+extern "C" tm_pid* tm_pid_start(const tm_pid_config* config, const char* heater_path) {
+  if (!config || !validPidConfig(*config)) return nullptr;
+  tm_pid* pid = new tm_pid();
+  pid->config = *config;
+  pid->heaterPath = heater_path ? heater_path : "";
+  std::memset(&pid->status, 0, sizeof(pid->status));
+  pid->status.output = config->out_min;
+  writeHeater(pid, 0);
+  pid->thread = std::thread(pidRun, pid);
+  return pid;
+}
+
+extern "C" void tm_pid_stop(tm_pid* pid) {
+  if (!pid) return;
+  {
+    std::lock_guard<std::mutex> guard(pid->lock);
+    pid->stopping = true;
+  }
+  pid->wake.notify_all();
+  pid->thread.join();
+  delete pid;
+}
+
+extern "C" int tm_pid_configure(tm_pid* pid, const tm_pid_config* config) {
+  if (!pid || !config || !validPidConfig(*config)) return -1;
+  std::lock_guard<std::mutex> guard(pid->lock);
+  pid->config = *config;
+  return 0;
+}
+
+extern "C" void tm_pid_feed(tm_pid* pid, double value) {
+  if (!pid || std::isnan(value)) return;
+  std::lock_guard<std::mutex> guard(pid->lock);
+  pid->feedback = value;
+  pid->feedbackAt = PidClock::now();
+  pid->haveFeedback = true;
+}
+
+extern "C" int tm_pid_get(tm_pid* pid, tm_pid_status* out) {
+  if (!pid || !out) return -1;
+  std::lock_guard<std::mutex> guard(pid->lock);
+  *out = pid->status;
+  if (pid->haveFeedback) out->feedback_age = secondsBetween(pid->feedbackAt, PidClock::now());
+  return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * Temperature Monitoring System - native engine (C ABI)
+ *
+ * Hot paths of app_heat.py exposed through a plain C interface so the Flask
+ * backend can load them with ctypes:
+ * - Serial line parser ("id:temp,id:temp,...")
+ * - Session store reader (CSV + .idx sidecar, optional time range)
+ * - Compressed session archive (.tmc chunk store) writer and reader
+ * - LTTB downsampler for graph data
+ * - Rolling per-probe statistics (EWMA, windowed mean/stddev/slope/min/max)
+ * - Streaming alert rules evaluated at ingest
+ * - Hierarchical timer wheel for probe staleness deadlines
+ * - Fixed-period PID heater loop on its own thread
+ *
+ * ABI rules: only C types cross the boundary, sessions are opaque handles,
+ * and TM_ABI_VERSION is bumped whenever a signature or struct changes.
+ * app_heat.py refuses to load a library with a different version and falls
+ * back to its pure-Python implementations.
+ *
+ * Build: make -C RPi/native   (produces RPi/native/libtempmon.so)
+ */
+
+#ifndef TEMPMON_NATIVE_H
+#define TEMPMON_NATIVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TM_ABI_VERSION 6
+#define TM_ID_MAX 24
+#define TM_STATS_MAX_WINDOWS 4
+
+#if defined(__GNUC__)
+#define TM_API __attribute__((visibility("default")))
+#else
+#define TM_API
+#endif
+
+/* One probe reading from a data line */
+typedef struct {
+  char id[TM_ID_MAX];  /* NUL-terminated hex ROM */
+  double temperature;  /* Celsius */
+} tm_reading;
+
+/* Opaque handle to a loaded session */
+typedef struct tm_session tm_session;
+
+/* Outcome of compacting one session CSV into a .tmc archive */
+typedef struct {
+  long rows;            /* Rows stored */
+  long skipped;         /* Lines dropped for an unreadable timestamp */
+  long chunks;
+  long columns;         /* Columns after the timestamp */
+  long source_bytes;    /* Size of the CSV */
+  long archive_bytes;   /* Size of the archive */
+  long timestamp_bits;  /* Encoded timestamp stream, all chunks */
+  long value_bits;      /* Encoded value streams, all chunks */
+} tm_archive_report;
+
+/* Statistics over one sliding time window */
+typedef struct {
+  double seconds;  /* Window length */
+  long count;      /* Samples in the window */
+  double span;     /* Seconds between its oldest and newest sample */
+  double mean;
+  double stddev;   /* Sample standard deviation, 0 below 2 samples */
+  double slope;    /* Least-squares dT/dt, °C per second */
+  double min;
+  double max;
+} tm_window_stats;
+
+/* Rolling statistics of one probe */
+typedef struct {
+  long count;      /* Samples ever added (since the last reset) */
+  double last;
+  double last_time;
+  double ewma;
+  int windows;
+  tm_window_stats window[TM_STATS_MAX_WINDOWS];
+} tm_probe_stats;
+
+/* Opaque handle to a set of per-probe statistics */
+typedef struct tm_stats tm_stats;
+
+/* Alert rule kinds (tm_alert_rule.kind) and what limit means */
+#define TM_ALERT_ABOVE 0      /* Temperature > limit (°C) */
+#define TM_ALERT_BELOW 1      /* Temperature < limit (°C) */
+#define TM_ALERT_SLOPE 2      /* |smoothed dT/dt| > limit (°C per second) */
+#define TM_ALERT_DEVIATION 3  /* |T(probe) - T(other)| > limit (°C) */
+#define TM_ALERT_STALE 4      /* No reading for more than limit seconds */
+
+typedef struct {
+  int kind;
+  int probe;          /* Probe index, 0..probes-1 */
+  int other;          /* Second probe (DEVIATION only) */
+  double limit;
+  double hysteresis;  /* Clears once back inside limit by this much */
+} tm_alert_rule;
+
+/* A rule starting (raised = 1) or stopping (raised = 0) to fire */
+typedef struct {
+  int rule;      /* Index into the rules given to tm_alerts_create */
+  int raised;
+  double time;   /* Reading (or tick) time that changed it */
+  double value;  /* The rule's measure: °C, °C/s, °C apart or seconds */
+} tm_alert_event;
+
+/* Opaque handle to a compiled rule set */
+typedef struct tm_alerts tm_alerts;
+
+/* Opaque handle to a timer wheel */
+typedef struct tm_wheel tm_wheel;
+
+/* PID heater loop settings (may be changed while it runs) */
+typedef struct {
+  double setpoint;          /* °C */
+  double kp;                /* Output per °C of error */
+  double ki;                /* Output per °C·s */
+  double kd;                /* Output per °C/s, on the measurement */
+  double derivative_tau;    /* Low-pass time constant of the D term, seconds */
+  double out_min;           /* Output clamp, usually 0..1 */
+  double out_max;
+  double period;            /* Seconds between loop ticks */
+  double window;            /* Time-proportioning window of the on/off heater, seconds */
+  double feedback_timeout;  /* Heater off if the probe is silent this long, seconds */
+} tm_pid_config;
+
+/* PID heater loop state and scheduling metrics */
+typedef struct {
+  int feedback_ok;      /* 0 = no fresh feedback, heater held off */
+  int heater_on;
+  double feedback;      /* Last probe value, °C */
+  double feedback_age;  /* Seconds since it arrived */
+  double output;        /* Clamped P + I + D */
+  double p;
+  double i;
+  double d;
+  long ticks;
+  long overruns;        /* Ticks skipped because the loop fell a period behind */
+  double jitter_last_us;  /* Wake-up lateness vs. the fixed schedule */
+  double jitter_mean_us;
+  double jitter_max_us;
+  double jitter_stddev_us;
+} tm_pid_status;
+
+/* Opaque handle to a running PID loop */
+typedef struct tm_pid tm_pid;
+
+TM_API int tm_abi_version(void);
+
+/*
+ * Parse a data line into out[0..max_out).
+ * Returns the number of readings, or -1 if the line is not a clean data
+ * frame (info/error messages, invalid IDs or values, too many readings);
+ * the caller then falls back to its message-by-message handling.
+ */
+TM_API int tm_parse_line(const char* line, tm_reading* out, int max_out);
+
+/*
+ * Load a session CSV, keeping rows with start <= timestamp <= end (ISO 8601
+ * strings, NULL = unbounded). Uses the .idx sidecar, if present, to seek to
+ * start. A .tmc archive (see tm_archive_write) is detected by its magic and
+ * read the same way, skipping whole chunks outside the range; there, bounds
+ * are compared as times and an unreadable bound is ignored. Returns NULL if
+ * the file cannot be read.
+ */
+TM_API tm_session* tm_session_open(const char* path, const char* start, const char* end);
+TM_API void tm_session_close(tm_session* session);
+TM_API int tm_session_columns(const tm_session* session);
+TM_API const char* tm_session_column(const tm_session* session, int column);
+TM_API long tm_session_rows(const tm_session* session);
+TM_API const char* tm_session_timestamp(const tm_session* session, long row);
+/* All timestamps joined with '\n' (one call instead of one per row) */
+TM_API const char* tm_session_timestamps(const tm_session* session);
+/* rows x columns values, row-major; NaN marks NC/missing/non-numeric cells */
+TM_API const double* tm_session_values(const tm_session* session);
+
+/*
+ * Compact a session CSV into a .tmc archive of chunks of chunk_rows rows.
+ * Timestamps (microseconds) are stored as delta-of-delta codes, numeric
+ * columns as zigzag deltas of fixed-point values, and text columns (e.g.
+ * Heater State) as deltas of indices into a per-chunk dictionary; repeated
+ * values cost one bit. Decoding gives back every cell as the same text, NC
+ * and empty cells apart, and timestamps in isoformat() form. Fills report
+ * (may be NULL); returns 0, or -1 if the CSV cannot be read or out_path
+ * written.
+ */
+TM_API int tm_archive_write(const char* csv_path, const char* out_path, long chunk_rows, tm_archive_report* report);
+
+/*
+ * Largest-Triangle-Three-Buckets downsampling of y[0..n) (x = index).
+ * Writes up to threshold ascending indices to out_idx and returns the count.
+ * NaN samples are treated as 0 when scoring but may still be selected.
+ */
+TM_API long tm_downsample_lttb(const double* y, long n, long threshold, long* out_idx);
+
+/*
+ * Rolling statistics for probes [0, probes), each over window_count sliding
+ * windows of windows[i] seconds (at most TM_STATS_MAX_WINDOWS). A probe keeps
+ * at most capacity samples (16 bytes each, allocated as they arrive); a window
+ * whose samples outgrow it reports a shorter span. Its min/max queues grow
+ * with the longest monotonic run in each window. The EWMA
+ * is time-weighted with time constant ewma_tau seconds (<= 0: last value).
+ * Returns NULL on bad arguments.
+ */
+TM_API tm_stats* tm_stats_create(int probes, long capacity, const double* windows, int window_count, double ewma_tau);
+TM_API void tm_stats_destroy(tm_stats* stats);
+/*
+ * Add a sample (time in seconds, any epoch). Amortized O(1) per window.
+ * A time earlier than the probe's last sample is treated as equal to it.
+ */
+TM_API void tm_stats_add(tm_stats* stats, int probe, double time, double value);
+/* Forget a probe's samples (its slot can then be reused) */
+TM_API void tm_stats_reset(tm_stats* stats, int probe);
+/* O(1) read of a probe's statistics; returns 0, or -1 for a bad probe */
+TM_API int tm_stats_get(const tm_stats* stats, int probe, tm_probe_stats* out);
+
+/*
+ * Compile rules over probes [0, probes) into per-probe rule lists, so a
+ * reading only visits the rules that name its probe. slope_tau is the time
+ * constant (seconds) of the smoothing behind SLOPE rules; queue_size bounds
+ * the event queue (oldest events are dropped when it is full). Returns NULL
+ * if a rule is malformed.
+ */
+TM_API tm_alerts* tm_alerts_create(const tm_alert_rule* rules, int count, int probes, double slope_tau, int queue_size);
+TM_API void tm_alerts_destroy(tm_alerts* alerts);
+/* Feed a reading; returns the number of queued events */
+TM_API int tm_alerts_ingest(tm_alerts* alerts, int probe, double time, double value);
+/* Evaluate STALE rules at time now (call about once a second) */
+TM_API int tm_alerts_tick(tm_alerts* alerts, double now);
+/* Move up to max_out queued events to out; returns how many */
+TM_API int tm_alerts_poll(tm_alerts* alerts, tm_alert_event* out, int max_out);
+/* Events lost to a full queue since creation */
+TM_API long tm_alerts_dropped(const tm_alerts* alerts);
+
+/*
+ * Hierarchical timer wheel for timers [0, timers): four levels of 256, 64,
+ * 64 and 64 buckets, tick_seconds per level-0 bucket, so deadlines up to
+ * ~6.7e6 ticks ahead are held exactly (later ones wait in the last level).
+ * Scheduling, rescheduling and cancelling are O(1); start is the current
+ * time in seconds. Returns NULL on bad arguments.
+ */
+TM_API tm_wheel* tm_wheel_create(int timers, double tick_seconds, double start);
+TM_API void tm_wheel_destroy(tm_wheel* wheel);
+/* (Re)arm a timer to fire at deadline (seconds, rounded up to a tick) */
+TM_API void tm_wheel_schedule(tm_wheel* wheel, int timer, double deadline);
+TM_API void tm_wheel_cancel(tm_wheel* wheel, int timer);
+/*
+ * Advance to now and write up to max_out timers that came due to out, in
+ * the order they came due; more are kept for the next call. Returns the count.
+ * Costs O(ticks elapsed + timers fired) for up to 255 ticks; a longer gap
+ * fires everything due and re-files the rest at once, in O(timers).
+ */
+TM_API int tm_wheel_advance(tm_wheel* wheel, double now, int* out, int max_out);
+
+/*
+ * Start a PID loop thread ticking every config->period on absolute
+ * deadlines. heater_path is a file that takes "1"/"0" (e.g. a sysfs GPIO
+ * value); NULL or "" runs it dry (output computed and reported only).
+ * Integration stops while the output is saturated in the direction of the
+ * error (anti-windup). Returns NULL on bad settings.
+ */
+TM_API tm_pid* tm_pid_start(const tm_pid_config* config, const char* heater_path);
+/* Stop the thread and switch the heater off */
+TM_API void tm_pid_stop(tm_pid* pid);
+/* Apply new settings from the next tick on; returns 0, or -1 if invalid */
+TM_API int tm_pid_configure(tm_pid* pid, const tm_pid_config* config);
+/* Latest value of the feedback probe */
+TM_API void tm_pid_feed(tm_pid* pid, double value);
+TM_API int tm_pid_get(tm_pid* pid, tm_pid_status* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TEMPMON_NATIVE_H
@@ -0,0 +1,514 @@
+// Temperature Monitoring System - session replay tool
+//
+// Replays recorded sessions (RPi/temperature_logs/*.csv) into a pseudo-terminal
+// using the Arduino firmware's exact line protocol, so SerialHandler (or any
+// other ingest path) can be load-tested without hardware:
+//
+//   [INIT] Temperature Monitoring System      <- startup banner
+//   28abc1230000beef:23.45,28def4560000cafe:22.10
+//   [ERROR] Failed to read sensor 28DEF4560000CAFE   <- for NC cells
+//
+// With --schema the firmware's default positional format is used instead:
+//
+//   SCHEMA:3f1a:28abc1230000beef,28def4560000cafe    <- sorted ROMs
+//   @3f1a/81250:23.45,                               <- empty = NC cell
+//
+// The /millis stamp comes from a simulated device clock (replay start = 0,
+// optionally running off by --clock-skew ppm) that also answers TIME pings.
+//
+// Each CSV row becomes one data frame. Probe columns are mapped to stable
+// synthetic ROM IDs derived from the column name (heater columns are
+// skipped). Frames are paced by the recorded timestamps divided by --speed.
+//
+// Usage:
+//   tempmon_replay [options] session.csv [more.csv ...]
+//     --speed N          Playback speed multiplier (default 1, 0 = as fast as possible)
+//     --baud N           Also pace bytes like a UART at N baud (default: unpaced)
+//     --link PATH        Symlink PATH to the pty slave (e.g. /tmp/ttyREPLAY0)
+//     --loop             Restart from the first file after the last one
+//     --error-rate P     Probability of an injected [ERROR] line per frame
+//     --truncate-rate P  Probability of cutting a frame short (line still ends)
+//     --burst-every N    Every N frames, send a burst with no delay ...
+//     --burst-size M     ... of M frames (default 10)
+//     --seed N           Random seed for injections (default 1)
+//     --schema           Send SCHEMA + positional frames (firmware FORMAT:SCHEMA)
+//     --clock-skew PPM   Device millis() runs PPM parts per million fast (default 0)
+//
+// Point the backend at the pty with SERIAL_PORT or by adding the --link path
+// to SERIAL_PORT_PATTERNS. Host commands (RESCAN, STATUS, SCHEMA, TIME, also
+// tagged as "#<id> CMD") are answered the way the firmware answers them, as
+// soon as they arrive (also while waiting for the next frame).
+//
+// Build: make -C RPi/native tempmon_replay
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// ============================================================================
+// OPTIONS
+// ============================================================================
+
+struct Options {
+  double speed = 1.0;
+  long baud = 0;
+  std::string link;
+  bool loop = false;
+  double errorRate = 0.0;
+  double truncateRate = 0.0;
+  long burstEvery = 0;
+  long burstSize = 10;
+  unsigned seed = 1;
+  bool schema = false;
+  double clockSkewPpm = 0.0;
+  std::vector<std::string> files;
+};
+
+static void usage(const char* argv0) {
+  std::fprintf(stderr,
+    "Usage: %s [--speed N] [--baud N] [--link PATH] [--loop] [--error-rate P]\n"
+    "          [--truncate-rate P] [--burst-every N] [--burst-size M] [--seed N] [--schema]\n"
+    "          [--clock-skew PPM] session.csv [more.csv ...]\n", argv0);
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--speed" && hasValue) options.speed = std::atof(argv[++i]);
+    else if (arg == "--baud" && hasValue) options.baud = std::atol(argv[++i]);
+    else if (arg == "--link" && hasValue) options.link = argv[++i];
+    else if (arg == "--loop") options.loop = true;
+    else if (arg == "--schema") options.schema = true;
+    else if (arg == "--error-rate" && hasValue) options.errorRate = std::atof(argv[++i]);
+    else if (arg == "--truncate-rate" && hasValue) options.truncateRate = std::atof(argv[++i]);
+    else if (arg == "--burst-every" && hasValue) options.burstEvery = std::atol(argv[++i]);
+    else if (arg == "--burst-size" && hasValue) options.burstSize = std::atol(argv[++i]);
+    else if (arg == "--seed" && hasValue) options.seed = static_cast<unsigned>(std::atol(argv[++i]));
+    else if (arg == "--clock-skew" && hasValue) options.clockSkewPpm = std::atof(argv[++i]);
+    else if (!arg.empty() && arg[0] == '-') return false;
+    else options.files.push_back(arg);
+  }
+  return !options.files.empty() && options.speed >= 0.0;
+}
+
+// ============================================================================
+// SESSION FILES
+// ============================================================================
+
+struct Probe {
+  size_t column;
+  std::string rom;  // 16 lowercase hex chars, as the firmware prints it in frames
+};
+
+struct Frame {
+  double time;  // Seconds since epoch (recorded)
+  std::vector<std::string> cells;
+};
+
+static std::vector<std::string> splitCommas(const std::string& line) {
+  std::vector<std::string> fields;
+  size_t begin = 0;
+  while (true) {
+    size_t comma = line.find(',', begin);
+    fields.push_back(line.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin));
+    if (comma == std::string::npos) break;
+    begin = comma + 1;
+  }
+  return fields;
+}
+
+static bool isHeaterColumn(const std::string& name) {
+  return name.compare(0, 6, "Heater") == 0 || name == "PID Output";
+}
+
+// Stable DS18B20-looking ROM (family 0x28) derived from the column name
+static std::string syntheticRom(const std::string& name) {
+  uint64_t hash = 1469598103934665603ULL;  // FNV-1a
+  for (unsigned char c : name) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  char rom[17];
+  std::snprintf(rom, sizeof(rom), "28%014llx",
+    static_cast<unsigned long long>(hash & 0x00FFFFFFFFFFFFFFULL));
+  return rom;
+}
+
+// SCHEMA frame for probes in ROM order; the version is the firmware's
+// CRC-16 (0xA001, seed 0xFFFF) over the ROM bytes
+static std::string schemaFrame(const std::vector<Probe>& probes, std::string& version) {
+  uint16_t hash = 0xFFFF;
+  std::string roms;
+  for (const Probe& probe : probes) {
+    for (size_t i = 0; i + 1 < probe.rom.size(); i += 2) {
+      hash ^= static_cast<uint8_t>(std::strtoul(probe.rom.substr(i, 2).c_str(), nullptr, 16));
+      for (int bit = 0; bit < 8; bit++) hash = (hash & 1) ? (hash >> 1) ^ 0xA001 : hash >> 1;
+    }
+    if (!roms.empty()) roms += ',';
+    roms += probe.rom;
+  }
+  char text[8];
+  std::snprintf(text, sizeof(text), "%04x", hash);
+  version = text;
+  return "SCHEMA:" + version + ":" + roms + "\r\n";
+}
+
+static double parseIsoTime(const std::string& text) {
+  struct tm fields;
+  std::memset(&fields, 0, sizeof(fields));
+  const char* rest = strptime(text.c_str(), "%Y-%m-%dT%H:%M:%S", &fields);
+  if (!rest) return -1.0;
+  double seconds = static_cast<double>(timegm(&fields));
+  if (*rest == '.') seconds += std::atof(rest);
+  return seconds;
+}
+
+static bool loadSession(const std::string& path, std::vector<Probe>& probes, std::vector<Frame>& frames) {
+  FILE* f = std::fopen(path.c_str(), "r");
+  if (!f) {
+    std::fprintf(stderr, "[REPLAY] Cannot open %s: %s\n", path.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  probes.clear();
+  frames.clear();
+  char* buffer = nullptr;
+  size_t capacity = 0;
+  bool header = true;
+  ssize_t length;
+  while ((length = getline(&buffer, &capacity, f)) > 0) {
+    std::string line(buffer, length);
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+    std::vector<std::string> fields = splitCommas(line);
+
+    if (header) {
+      for (size_t i = 1; i < fields.size(); i++) {
+        if (!isHeaterColumn(fields[i])) probes.push_back({i, syntheticRom(fields[i])});
+      }
+      header = false;
+      continue;
+    }
+
+    double time = parseIsoTime(fields[0]);
+    if (fields.size() <= 1 || time < 0.0) continue;
+    frames.push_back({time, fields});
+  }
+  std::free(buffer);
+  std::fclose(f);
+  return true;
+}
+
+// ============================================================================
+// PSEUDO-TERMINAL OUTPUT
+// ============================================================================
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+  stopRequested = 1;
+}
+
+struct Pty {
+  int master = -1;
+  int slave = -1;  // Held open so writes never fail while no reader is attached
+  std::string path;
+};
+
+static bool openPty(Pty& pty) {
+  pty.master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (pty.master < 0 || grantpt(pty.master) != 0 || unlockpt(pty.master) != 0) return false;
+  pty.path = ptsname(pty.master);
+  pty.slave = open(pty.path.c_str(), O_RDWR | O_NOCTTY);
+  if (pty.slave < 0) return false;
+
+  // Raw mode, like the Arduino's CDC-ACM port (no echo back into the master)
+  struct termios attributes;
+  tcgetattr(pty.slave, &attributes);
+  cfmakeraw(&attributes);
+  tcsetattr(pty.slave, TCSANOW, &attributes);
+
+  fcntl(pty.master, F_SETFL, fcntl(pty.master, F_GETFL) | O_NONBLOCK);
+  return true;
+}
+
+static double monotonicNow() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void sleepUntil(double deadline) {
+  double remaining = deadline - monotonicNow();
+  if (remaining <= 0.0) return;
+  struct timespec pause;
+  pause.tv_sec = static_cast<time_t>(remaining);
+  pause.tv_nsec = static_cast<long>((remaining - pause.tv_sec) * 1e9);
+  nanosleep(&pause, nullptr);
+}
+
+struct Stats {
+  unsigned long frames = 0;
+  unsigned long bytes = 0;
+  unsigned long errors = 0;
+  unsigned long truncated = 0;
+};
+
+class Writer {
+ public:
+  Writer(Pty& pty, long baud, Stats& stats) : pty_(pty), baud_(baud), stats_(stats) {}
+
+  bool send(const std::string& text) {
+    size_t offset = 0;
+    while (offset < text.size() && !stopRequested) {
+      ssize_t written = write(pty_.master, text.data() + offset, text.size() - offset);
+      if (written < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+          usleep(1000);  // Reader is behind; this is the backpressure we want to measure
+          continue;
+        }
+        std::fprintf(stderr, "[REPLAY] Write error: %s\n", std::strerror(errno));
+        return false;
+      }
+      offset += written;
+    }
+    stats_.bytes += text.size();
+    if (baud_ > 0) {
+      // 8N1: 10 bit times per byte
+      wireFreeAt_ = std::max(wireFreeAt_, monotonicNow()) + text.size() * 10.0 / baud_;
+      sleepUntil(wireFreeAt_);
+    }
+    return true;
+  }
+
+ private:
+  Pty& pty_;
+  long baud_;
+  Stats& stats_;
+  double wireFreeAt_ = 0.0;
+};
+
+// The firmware's millis(), counted from replay start
+struct DeviceClock {
+  double started;
+  double skewPpm;
+
+  uint32_t millis() const {
+    double ms = (monotonicNow() - started) * 1000.0 * (1.0 + skewPpm / 1e6);
+    return static_cast<uint32_t>(static_cast<uint64_t>(ms));
+  }
+};
+
+// Answer host commands the way Arduino/src/main.cpp does
+static void answerCommands(Pty& pty, std::string& pending, Writer& writer, size_t probeCount,
+                           const std::string& schema, const DeviceClock& clock) {
+  char buffer[256];
+  ssize_t count;
+  while ((count = read(pty.master, buffer, sizeof(buffer))) > 0) {
+    pending.append(buffer, count);
+  }
+
+  size_t newline;
+  while ((newline = pending.find('\n')) != std::string::npos) {
+    std::string command = pending.substr(0, newline);
+    pending.erase(0, newline + 1);
+    while (!command.empty() && (command.back() == '\r' || command.back() == ' ')) command.pop_back();
+
+    if (command.compare(0, 5, "TIME:") == 0) {
+      writer.send(command + ":" + std::to_string(clock.millis()) + "\r\n");
+      continue;
+    }
+
+    // "#<id> CMD": the reply echoes the id ("#<id> OK ...", "#<id> ERR ...")
+    std::string tag;
+    if (!command.empty() && command[0] == '#') {
+      size_t space = command.find(' ');
+      tag = command.substr(1, space == std::string::npos ? std::string::npos : space - 1);
+      command = space == std::string::npos ? std::string() : command.substr(space + 1);
+    }
+    auto reply = [&](const char* untagged, const char* tagged, const std::string& text) {
+      writer.send((tag.empty() ? std::string(untagged) : "#" + tag + tagged) + text + "\r\n");
+    };
+
+    if (command == "RESCAN") {
+      reply("[INFO] ", " OK ", "RESCAN_COMPLETE Found " + std::to_string(probeCount) + " sensors");
+    } else if (command == "STATUS") {
+      reply("[INFO] ", " OK ", "Sensors: " + std::to_string(probeCount) + " | Resolution: replay | Poll interval: replay");
+    } else if (command == "SCHEMA" && !schema.empty()) {
+      writer.send(schema);
+      if (!tag.empty()) writer.send("#" + tag + " OK\r\n");
+    } else if (!command.empty()) {
+      reply("[WARN] ", " ERR ", "Unknown command: " + command);
+    } else if (!tag.empty()) {
+      writer.send("#" + tag + " OK\r\n");
+    }
+  }
+}
+
+// Wait for the next frame's deadline, answering commands as they arrive so a
+// TIME ping or tagged command is not held for the rest of the frame gap
+static void serveUntil(double deadline, Pty& pty, std::string& pending, Writer& writer, size_t probeCount,
+                       const std::string& schema, const DeviceClock& clock) {
+  while (!stopRequested) {
+    answerCommands(pty, pending, writer, probeCount, schema, clock);
+    double remaining = deadline - monotonicNow();
+    if (remaining <= 0.0) return;
+    struct pollfd input = {pty.master, POLLIN, 0};
+    struct timespec timeout;
+    timeout.tv_sec = static_cast<time_t>(remaining);
+    timeout.tv_nsec = static_cast<long>((remaining - timeout.tv_sec) * 1e9);
+    ppoll(&input, 1, &timeout, nullptr);  // EINTR: re-checked above
+  }
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  Pty pty;
+  if (!openPty(pty)) {
+    std::fprintf(stderr, "[REPLAY] Cannot open pseudo-terminal: %s\n", std::strerror(errno));
+    return 1;
+  }
+  if (!options.link.empty()) {
+    unlink(options.link.c_str());
+    if (symlink(pty.path.c_str(), options.link.c_str()) != 0) {
+      std::fprintf(stderr, "[REPLAY] Cannot link %s: %s\n", options.link.c_str(), std::strerror(errno));
+      return 1;
+    }
+  }
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::fprintf(stderr, "[REPLAY] Serving %s%s%s\n", pty.path.c_str(),
+    options.link.empty() ? "" : " via ", options.link.c_str());
+
+  Stats stats;
+  Writer writer(pty, options.baud, stats);
+  std::mt19937 rng(options.seed);
+  std::uniform_real_distribution<double> chance(0.0, 1.0);
+  std::string pendingCommands;
+  std::vector<Probe> probes;
+  std::vector<Frame> frames;
+  std::string schema;  // Current SCHEMA frame (--schema only)
+  std::string version;
+  const long schemaInterval = 60;  // Frames between SCHEMA resends, as the firmware
+  long sinceSchema = 0;
+
+  writer.send("[INIT] Temperature Monitoring System\r\n");
+  writer.send("[INIT] Ready\r\n");
+
+  double started = monotonicNow();
+  DeviceClock clock{started, options.clockSkewPpm};
+  double playhead = started;  // Monotonic time at which the next frame is due
+  long sinceBurst = 0;
+  long burstLeft = 0;
+
+  do {
+    for (size_t file = 0; file < options.files.size() && !stopRequested; file++) {
+      if (!loadSession(options.files[file], probes, frames)) continue;
+      std::fprintf(stderr, "[REPLAY] %s: %zu probes, %zu frames\n",
+        options.files[file].c_str(), probes.size(), frames.size());
+      if (options.schema) {
+        std::sort(probes.begin(), probes.end(),
+          [](const Probe& a, const Probe& b) { return a.rom < b.rom; });
+        schema = schemaFrame(probes, version);
+        sinceSchema = schemaInterval;  // New file, new probe set: announce first
+      }
+
+      for (size_t i = 0; i < frames.size() && !stopRequested; i++) {
+        // Bursts send frames back-to-back, compressing their recorded spacing
+        if (options.burstEvery > 0 && burstLeft == 0 && ++sinceBurst >= options.burstEvery) {
+          burstLeft = options.burstSize;
+          sinceBurst = 0;
+        }
+        if (burstLeft > 0) {
+          burstLeft--;
+        } else if (i > 0 && options.speed > 0.0) {
+          playhead += (frames[i].time - frames[i - 1].time) / options.speed;
+          serveUntil(playhead, pty, pendingCommands, writer, probes.size(), schema, clock);
+          playhead = std::max(playhead, monotonicNow());  // Don't catch up after a stall
+        }
+
+        answerCommands(pty, pendingCommands, writer, probes.size(), schema, clock);
+
+        // NC cells: the firmware reports the failed sensor and omits it from the
+        // frame (or leaves its position empty in schema mode)
+        std::string frame;
+        bool anyValue = false;
+        for (size_t p = 0; p < probes.size(); p++) {
+          const Probe& probe = probes[p];
+          const std::vector<std::string>& cells = frames[i].cells;
+          if (options.schema && p > 0) frame += ',';
+          char* end = nullptr;
+          double value = probe.column < cells.size() ? std::strtod(cells[probe.column].c_str(), &end) : 0.0;
+          if (!end || end == cells[probe.column].c_str()) {
+            std::string upper = probe.rom;
+            for (char& c : upper) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            writer.send("[ERROR] Failed to read sensor " + upper + "\r\n");
+            continue;
+          }
+          char reading[48];
+          if (options.schema) {
+            std::snprintf(reading, sizeof(reading), "%.2f", value);
+          } else {
+            std::snprintf(reading, sizeof(reading), "%s%s:%.2f", frame.empty() ? "" : ",", probe.rom.c_str(), value);
+          }
+          frame += reading;
+          anyValue = true;
+        }
+        if (!anyValue) frame.clear();
+        if (options.schema && !frame.empty()) {
+          if (sinceSchema >= schemaInterval) {
+            writer.send(schema);
+            sinceSchema = 0;
+          }
+          sinceSchema++;
+          frame = "@" + version + "/" + std::to_string(clock.millis()) + ":" + frame;
+        }
+
+        if (chance(rng) < options.errorRate) {
+          writer.send("[ERROR] CRC_FAILED for sensor 1\r\n");
+          stats.errors++;
+        }
+        if (frame.empty()) continue;
+        if (chance(rng) < options.truncateRate) {
+          frame.resize(1 + rng() % frame.size());
+          stats.truncated++;
+        }
+        if (!writer.send(frame + "\r\n")) stopRequested = 1;
+        stats.frames++;
+      }
+    }
+  } while (options.loop && !stopRequested);
+
+  double elapsed = monotonicNow() - started;
+  std::fprintf(stderr, "[REPLAY] %lu frames, %lu bytes in %.2fs (%.1f frames/s, %.0f B/s), %lu errors, %lu truncated\n",
+    stats.frames, stats.bytes, elapsed, stats.frames / elapsed, stats.bytes / elapsed, stats.errors, stats.truncated);
+
+  if (!options.link.empty()) unlink(options.link.c_str());
+  close(pty.slave);
+  close(pty.master);
+  return 0;
+}